@@ -17,6 +17,14 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and that frequency divided by
+   TIMER_FREQ, rounded to nearest: the PIT count of one tick. */
+#define PIT_FREQ 1193180
+#define PIT_TICK_COUNT ((PIT_FREQ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks that fit in the 16-bit PIT counter at once. */
+#define TICKLESS_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
@@ -24,24 +32,41 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Tickless idle.
+
+   If true, the idle thread stops the periodic tick while it
+   halts and instead arms the PIT in one-shot mode to fire when
+   the next sleeper is due, saving the wakeups in between.
+   Controlled by kernel command-line option "-tickless".
+
+   The one-shot is armed so that it expires exactly on a tick
+   boundary, and the interrupt then accounts for every tick it
+   covered, so `ticks' stays in phase with real time no matter
+   how long the CPU idles.  While it is armed, timer_ticks()
+   reads the counter to include the ticks elapsed so far. */
+bool timer_tickless;
+
+static bool oneshot;            /* PIT armed in one-shot mode? */
+static unsigned oneshot_base;   /* Counts of the tick elapsed at arming. */
+static unsigned oneshot_count;  /* Counts the one-shot was armed with. */
+static int oneshot_ticks;       /* Ticks it covers when it expires. */
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
+static void pit_periodic(void);
+static void pit_oneshot(unsigned count);
+static unsigned pit_read(void);
+static bool pit_irq_pending(void);
+static int64_t oneshot_elapsed(void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init(void)
 {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb(0x40, count & 0xff);
-	outb(0x40, count >> 8);
-
+	pit_periodic();
 	intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -77,6 +102,8 @@ timer_ticks(void)
 {
 	enum intr_level old_level = intr_disable();
 	int64_t t = ticks;
+	if (oneshot)
+		t += oneshot_elapsed();
 	intr_set_level(old_level);
 	barrier();
 	return t;
@@ -125,12 +152,93 @@ void timer_print_stats(void)
 	printf("Timer: %" PRId64 " ticks\n", timer_ticks());
 }
 
+/* Called by the idle thread, with interrupts off, just before
+   it halts.  If tickless idle is enabled and no sleeper is due
+   on the next tick, switches the PIT to a one-shot that expires
+   on the tick boundary when the next sleeper is due, or as far
+   ahead as the counter reaches. */
+void timer_idle_enter(void)
+{
+	int64_t delta;
+	unsigned remaining;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	/* The MLFQS recomputes priorities on tick boundaries, so it
+	   keeps the periodic tick. */
+	if (!timer_tickless || thread_mlfqs || oneshot)
+		return;
+
+	/* If a tick arrived while interrupts were off, it has not
+	   been counted yet; let it through first. */
+	delta = get_next_tick_to_awake() - ticks;
+	if (delta <= 1 || pit_irq_pending())
+		return;
+	if (delta > TICKLESS_MAX_TICKS)
+		delta = TICKLESS_MAX_TICKS;
+
+	/* In mode 2 the counter runs from PIT_TICK_COUNT down to 1,
+	   so it tells how far into the current tick we are. */
+	remaining = pit_read();
+	oneshot_base = PIT_TICK_COUNT - remaining;
+	oneshot_count = (delta - 1) * PIT_TICK_COUNT + remaining;
+	oneshot_ticks = delta;
+	oneshot = true;
+	pit_oneshot(oneshot_count);
+}
+
+/* Called by the scheduler, with interrupts off, when the idle
+   thread gives up the CPU.  Credits the whole ticks that passed
+   while idle and returns their number, then rearms the PIT to
+   finish the tick in progress, after which the periodic tick
+   resumes in phase. */
+int64_t timer_idle_exit(void)
+{
+	int64_t whole;
+	unsigned remaining, elapsed;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	/* If the one-shot already expired, its interrupt is pending
+	   and will do the accounting. */
+	if (!oneshot || pit_irq_pending())
+		return 0;
+	remaining = pit_read();
+	if (remaining == 0 || remaining > oneshot_count)
+		return 0;
+
+	elapsed = oneshot_base + oneshot_count - remaining;
+	whole = elapsed / PIT_TICK_COUNT;
+	ticks += whole;
+
+	oneshot_base = elapsed % PIT_TICK_COUNT;
+	oneshot_count = PIT_TICK_COUNT - oneshot_base;
+	oneshot_ticks = 1;
+	pit_oneshot(oneshot_count);
+	return whole;
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
-	ticks++;
-	thread_tick(); // 코드 제출할 때 검사하는 함수
+	int n = 1;
+
+	/* A one-shot expires on a tick boundary; go back to periodic
+	   mode from here so the next tick stays in phase, and account
+	   for each tick it covered. */
+	if (oneshot)
+	{
+		n = oneshot_ticks;
+		oneshot = false;
+		pit_periodic();
+	}
+
+	while (n-- > 0)
+	{
+		ticks++;
+		thread_tick(); // 코드 제출할 때 검사하는 함수
+	}
 	int64_t next_tick;
 	next_tick = get_next_tick_to_awake();
 
@@ -140,6 +248,65 @@ timer_interrupt(struct intr_frame *args UNUSED)
 	}
 }
 
+/* Programs PIT counter 0 to interrupt every PIT_TICK_COUNT
+   input cycles. */
+static void
+pit_periodic(void)
+{
+	uint16_t count = PIT_TICK_COUNT;
+
+	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb(0x40, count & 0xff);
+	outb(0x40, count >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, COUNT input cycles
+   from now. */
+static void
+pit_oneshot(unsigned count)
+{
+	ASSERT(count > 0 && count <= 0xffff);
+
+	outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb(0x40, count & 0xff);
+	outb(0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static unsigned
+pit_read(void)
+{
+	unsigned lo, hi;
+
+	outb(0x43, 0x00); /* CW: latch counter 0. */
+	lo = inb(0x40);
+	hi = inb(0x40);
+	return lo | (hi << 8);
+}
+
+/* Returns true if the PIC has latched a timer interrupt that
+   has not been delivered yet. */
+static bool
+pit_irq_pending(void)
+{
+	outb(0x20, 0x0a); /* OCW3: read the master's IRR. */
+	return (inb(0x20) & 0x01) != 0;
+}
+
+/* Returns the number of whole ticks that have passed since the
+   armed one-shot started, not yet added to `ticks'. */
+static int64_t
+oneshot_elapsed(void)
+{
+	unsigned remaining = pit_read();
+
+	/* After expiring, a mode 0 counter wraps to 0xffff and keeps
+	   counting down. */
+	if (remaining == 0 || remaining > oneshot_count)
+		return oneshot_ticks;
+	return (oneshot_base + oneshot_count - remaining) / PIT_TICK_COUNT;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -50,13 +52,25 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.  Lookups hold open_inodes_lock
+ * for reading, so concurrent opens of already open inodes do not
+ * serialize; adding and removing inodes hold it for writing. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of `struct inode's. */
+static struct kmem_cache *inode_cache;
+
+static struct inode *find_open_inode (disk_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
+	if (inode_cache == NULL)
+		PANIC ("cannot create inode cache");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,39 +115,62 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
-	struct inode *inode;
+	struct rwlock_hold hold;
+	struct inode *inode, *open;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_acquire_read (&open_inodes_lock, &hold);
+	inode = inode_reopen (find_open_inode (sector));
+	rwlock_release_read (&open_inodes_lock, &hold);
+	if (inode != NULL)
+		return inode;
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_cache);
 	if (inode == NULL)
 		return NULL;
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize, reading the disk without holding the lock. */
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Someone else may have opened it meanwhile. */
+	rwlock_acquire_write (&open_inodes_lock);
+	open = inode_reopen (find_open_inode (sector));
+	if (open == NULL)
+		list_push_front (&open_inodes, &inode->elem);
+	rwlock_release_write (&open_inodes_lock);
+	if (open != NULL) {
+		kmem_cache_free (inode_cache, inode);
+		inode = open;
+	}
 	return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Returns the open inode for SECTOR, or a null pointer if there
+ * is none.  The caller must hold open_inodes_lock. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode;
+	}
+	return NULL;
+}
+
+/* Reopens and returns INODE.  Readers of open_inodes reopen
+ * inodes concurrently, so the count is updated atomically. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -143,20 +180,45 @@ inode_get_inumber (const struct inode *inode) {
 	return inode->sector;
 }
 
+/* Returns the disk sector that contains byte offset POS within
+ * INODE, or -1 if INODE does not contain data for a byte at offset
+ * POS. */
+disk_sector_t
+inode_sector_at (const struct inode *inode, off_t pos) {
+	return byte_to_sector (inode, pos);
+}
+
 /* Closes INODE and writes it to disk.
  * If this was the last reference to INODE, frees its memory.
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	int cnt;
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
+	/* Other openers remain: drop our count without the lock.  Only
+	 * the last opener needs it, so that no reader reopens INODE
+	 * once the count reaches zero. */
+	cnt = __atomic_load_n (&inode->open_cnt, __ATOMIC_RELAXED);
+	while (cnt > 1)
+		if (__atomic_compare_exchange_n (&inode->open_cnt, &cnt, cnt - 1,
+					false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
+	rwlock_acquire_write (&open_inodes_lock);
+	last = __atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED) == 0;
+	if (last) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+	}
+	rwlock_release_write (&open_inodes_lock);
 
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
@@ -164,7 +226,7 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
+		kmem_cache_free (inode_cache, inode);
 	}
 }
 
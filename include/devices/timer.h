@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -20,4 +21,8 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+extern bool timer_tickless;
+void timer_idle_enter (void);
+int64_t timer_idle_exit (void);
+
 #endif /* devices/timer.h */
@@ -0,0 +1,62 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+ *
+ * This is a pairing heap: a heap-ordered tree in which each node
+ * keeps its children in a doubly linked sibling list.  Insertion
+ * and finding the maximum take constant time; removing the
+ * maximum, or any other element, takes O(log n) amortized time.
+ *
+ * Like lists and hash tables, heaps do not use dynamic
+ * allocation.  Each structure that can be in a heap embeds a
+ * struct heap_elem member, and heap_entry converts a heap
+ * element back to the structure that contains it.  See
+ * lib/kernel/list.h for a detailed explanation of the technique.
+ *
+ * An element's key must not change while it is in a heap.  To
+ * change it, remove the element, update the key, and push the
+ * element again. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* First child. */
+	struct heap_elem *next;     /* Next sibling. */
+	struct heap_elem *prev;     /* Previous sibling, or parent. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+ * the structure that HEAP_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->next     \
+		- offsetof (STRUCT, MEMBER.next)))
+
+/* Compares the value of two heap elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+		const struct heap_elem *b,
+		void *aux);
+
+/* Heap, ordered so that the greatest element is on top. */
+struct heap {
+	struct heap_elem *root;     /* Greatest element, or NULL. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+bool heap_empty (const struct heap *);
+struct heap_elem *heap_max (const struct heap *);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
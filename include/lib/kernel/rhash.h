@@ -0,0 +1,108 @@
+#ifndef __LIB_KERNEL_RHASH_H
+#define __LIB_KERNEL_RHASH_H
+
+/* Open-addressing hash table with incremental resizing.
+ *
+ * This is an alternative to the chained table in hash.h with the
+ * same intrusive interface: each structure that can be in an
+ * rhash embeds a struct rhash_elem, and rhash_entry() converts
+ * back to the containing structure.
+ *
+ * Elements live directly in an array of slots, placed by linear
+ * probing with the Robin Hood rule: an element being inserted
+ * takes the slot of any element that is closer to its own home
+ * slot, and the displaced element moves on.  That keeps probe
+ * sequences short and lets a failed lookup stop early.  Deletion
+ * shifts the following elements back instead of leaving
+ * tombstones.
+ *
+ * When the table grows or shrinks it does not move every element
+ * at once, as rehash() in hash.c does.  It allocates the new slot
+ * array and keeps the old one alongside, and each later
+ * insertion, lookup or deletion migrates a few old slots.
+ * Lookups search both arrays until the old one is empty.  No
+ * single operation therefore takes time proportional to the
+ * table size, apart from clearing the new slot array. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hash element. */
+struct rhash_elem {
+	uint64_t hash;              /* Hash value, cached by the table. */
+};
+
+/* Converts pointer to hash element RHASH_ELEM into a pointer to
+ * the structure that RHASH_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the hash element. */
+#define rhash_entry(RHASH_ELEM, STRUCT, MEMBER)                 \
+	((STRUCT *) ((uint8_t *) (RHASH_ELEM)                   \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Computes and returns the hash value for hash element E, given
+ * auxiliary data AUX. */
+typedef uint64_t rhash_hash_func (const struct rhash_elem *e, void *aux);
+
+/* Compares the value of two hash elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool rhash_less_func (const struct rhash_elem *a,
+		const struct rhash_elem *b,
+		void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+ * data AUX. */
+typedef void rhash_action_func (struct rhash_elem *e, void *aux);
+
+/* Hash table. */
+struct rhash {
+	size_t elem_cnt;            /* Number of elements in table. */
+	struct rhash_elem **slots;  /* Array of `slot_cnt' slots. */
+	size_t slot_cnt;            /* Number of slots, a power of 2. */
+
+	/* Slot array being migrated away from, or null. */
+	struct rhash_elem **old_slots;
+	size_t old_slot_cnt;        /* Number of old slots, a power of 2. */
+	size_t migrate_start;       /* First old slot migrated. */
+	size_t migrate_cnt;         /* Old slots migrated so far. */
+
+	rhash_hash_func *hash;      /* Hash function. */
+	rhash_less_func *less;      /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `hash' and `less'. */
+};
+
+/* A hash table iterator. */
+struct rhash_iterator {
+	struct rhash *hash;         /* The hash table. */
+	bool in_old;                /* Walking old_slots? */
+	size_t pos;                 /* Slots of the current array done. */
+	struct rhash_elem *elem;    /* Current hash element. */
+};
+
+/* Basic life cycle. */
+bool rhash_init (struct rhash *, rhash_hash_func *, rhash_less_func *,
+		void *aux);
+void rhash_clear (struct rhash *, rhash_action_func *);
+void rhash_destroy (struct rhash *, rhash_action_func *);
+
+/* Search, insertion, deletion. */
+bool rhash_insert (struct rhash *, struct rhash_elem *new,
+		struct rhash_elem **old);
+bool rhash_replace (struct rhash *, struct rhash_elem *new,
+		struct rhash_elem **old);
+struct rhash_elem *rhash_find (struct rhash *, struct rhash_elem *);
+struct rhash_elem *rhash_delete (struct rhash *, struct rhash_elem *);
+
+/* Iteration. */
+void rhash_apply (struct rhash *, rhash_action_func *);
+void rhash_first (struct rhash_iterator *, struct rhash *);
+struct rhash_elem *rhash_next (struct rhash_iterator *);
+struct rhash_elem *rhash_cur (struct rhash_iterator *);
+
+/* Information. */
+size_t rhash_size (struct rhash *);
+bool rhash_empty (struct rhash *);
+
+#endif /* lib/kernel/rhash.h */
@@ -11,6 +11,11 @@
 /* Kernel virtual address at which all physical memory is mapped. */
 #define LOADER_PHYS_BASE 0x200000
 
+/* Physical memory below this address is mapped by the page
+   tables start.S sets up (128 pages of 2 MB), which are all the
+   kernel has until paging_init() runs. */
+#define LOADER_MAP_END 0x10000000
+
 /* Multiboot infos */
 #define MULTIBOOT_INFO       0x7000
 #define MULTIBOOT_FLAG       MULTIBOOT_INFO
@@ -1,14 +1,17 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore
 {
 	unsigned value;		 /* Current value. */
-	struct list waiters; /* List of waiting threads. */
+	struct heap waiters; /* Waiting threads, by priority. */
+	unsigned wait_seq;	 /* Orders waiters of equal priority. */
 };
 
 void sema_init(struct semaphore *, unsigned value); // 세마포어 초기화
@@ -17,18 +20,36 @@ bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
 void sema_self_test(void);
 bool semaphore_compare_priority(const struct list_elem *l, const struct list_elem *s, void *aux);
+/* Priority donated to a thread through something it holds that
+   other threads wait for.  Kept in the holder's held_locks heap,
+   so the holder runs at the highest priority waiting on any of
+   the things it holds. */
+struct donation
+{
+	int priority;			/* Highest priority among waiters. */
+	struct heap_elem elem;	/* Element in holder's held_locks. */
+};
+
 /* Lock. */
 struct lock
 {
 	struct thread *holder;		/* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct donation donation;	/* Donation to holder. */
+
+	/* Used only if lock_profile is true. */
+	struct lock_site *prof_site; /* Profile entry of current hold. */
+	int64_t acquired_at;		 /* Tick of acquisition. */
 };
 
+extern bool lock_profile;
+
 void lock_init(struct lock *);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_held_by_current_thread(const struct lock *);
+void lock_print_stats(void);
 
 /* Condition variable. */
 struct condition
@@ -41,6 +62,40 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Readers-writer lock.  Any number of readers or a single writer
+   may hold it at a time.  Writers are preferred: once a writer
+   waits, new readers queue behind it, so a steady stream of
+   readers cannot starve writers.  Waiters donate their priority
+   to the writer or to every reader holding the lock. */
+struct rwlock
+{
+	struct thread *writer;			/* Writer holding it, or NULL. */
+	struct donation donation;		/* Donation to the writer. */
+	unsigned reader_cnt;			/* Number of readers holding it. */
+	struct list readers;			/* Readers' struct rwlock_hold. */
+	struct semaphore read_waiters;	/* Queue of waiting readers. */
+	struct semaphore write_waiters; /* Queue of waiting writers. */
+	int max_priority;				/* Highest priority among waiters. */
+};
+
+/* A reader's hold on an rwlock.  The reader provides it, usually
+   on its stack, so a thread may read-hold any number of rwlocks. */
+struct rwlock_hold
+{
+	struct rwlock *rwlock;			/* Rwlock held. */
+	struct thread *reader;			/* Thread holding it. */
+	struct donation donation;		/* Donation to the reader. */
+	struct list_elem elem;			/* Element in rwlock's readers. */
+};
+
+void rwlock_init(struct rwlock *);
+void rwlock_acquire_read(struct rwlock *, struct rwlock_hold *);
+void rwlock_release_read(struct rwlock *, struct rwlock_hold *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+bool rwlock_held_for_write(const struct rwlock *);
+void rwlock_update_donation(struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
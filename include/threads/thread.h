@@ -2,9 +2,12 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -28,6 +31,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the MLFQS. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -93,14 +101,26 @@ struct thread {
 	int priority;                       /* Priority. */
 
 	int64_t awake_ticks; 				/* Awake. */
+	struct heap_elem sleep_elem;        /* Element in the sleep heap. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
 
 	int original_priority;   /* save original priority before the doante */
-	struct lock *wait_on_lock;  
-  	struct list donations; /* remember donation */
-  	struct list_elem donation_elem; /* for keep as list */
+	struct lock *wait_on_lock;          /* Lock we are waiting for. */
+	struct heap held_locks;             /* Donations received, by priority. */
+	struct rwlock *wait_on_rwlock;      /* Rwlock we are waiting for. */
+	struct semaphore *wait_on_sema;     /* Semaphore we are blocked on. */
+	struct heap_elem wait_elem;         /* Element in its waiters heap. */
+	unsigned wait_seq;                  /* Arrival order among waiters. */
+
+	/* Owned by thread.c, used by the MLFQS only. */
+	int nice;                           /* Niceness. */
+	fixed_t recent_cpu;                 /* Recent CPU use, decayed. */
+	bool mlfqs_dirty;                   /* On the priority-update list? */
+	struct list_elem mlfqs_elem;        /* Priority-update list element. */
+	struct list_elem all_elem;          /* List element for all threads. */
+	bool background;                    /* From thread_create_background()? */
   
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -109,6 +129,7 @@ struct thread {
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	unsigned long long fault_cnt;       /* Page faults taken. */
 #endif
 
 	/* Owned by thread.c. */
@@ -129,6 +150,7 @@ void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_background (const char *name, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -155,11 +177,13 @@ void thread_awake(int64_t ticks);
 void update_next_tick_to_awake(int64_t ticks);
 int64_t get_next_tick_to_awake(void);
 
-bool thread_compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 void thread_compare_preemption(void);
 
-bool thread_compare_donate_priority(const struct list_elem *a, const struct list_elem *b, void *aux); // 요소 비교하는 함수
 void donate_priority (void);
+void add_with_lock (struct lock *lock);
 void remove_with_lock (struct lock *lock);
+void donation_add (struct thread *holder, struct donation *, int priority);
+void donation_set (struct thread *holder, struct donation *, int priority);
+void donation_remove (struct thread *holder, struct donation *);
 void refresh_priority(void);
 #endif /* threads/thread.h */
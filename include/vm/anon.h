@@ -1,13 +1,34 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
 
+/* Swap slot of a page that is not in swap. */
+#define SWAP_SLOT_NONE SIZE_MAX
+
+/* Most pages one anon_swap_write_frames() or anon_swap_in_pages()
+ * call moves to or from disk with a single disk command. */
+#define SWAP_CLUSTER 16
+
 struct anon_page {
+	size_t slot;                /* Swap slot, or SWAP_SLOT_NONE. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+struct frame;
+bool anon_swap_write_frames (struct frame *frames[], size_t cnt);
+void anon_swap_out_frames (struct frame *frames[], size_t cnt);
+void anon_swap_in_pages (struct page *pages[], size_t cnt);
+void anon_swap_share (struct page *dst, struct page *src);
+void anon_swap_release (struct page *page);
+
+/* Swap cache. */
+struct frame *anon_swap_cache_find (size_t slot);
+bool anon_swap_cache_fill (struct page *page);
+void anon_swap_cache_remove (struct frame *frame);
 
 #endif
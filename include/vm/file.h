@@ -6,12 +6,42 @@
 struct page;
 enum vm_type;
 
+/* A page of a file mapped with mmap(). */
 struct file_page {
+	struct file *file;          /* The page's own handle to the file. */
+	off_t ofs;                  /* Offset of the page in the file. */
+	size_t read_bytes;          /* Bytes of file data; the rest is zeros. */
 };
 
+/* A mapping made by mmap().  Each of its pages points to it, and it
+ * is freed with the last of them.  Only the owning process uses
+ * it. */
+struct mmap_region {
+	void *base;                 /* Address of the first page. */
+	size_t page_cnt;            /* Number of pages mapped. */
+	size_t ref_cnt;             /* Number of pages pointing here. */
+
+	/* Readahead state, in page indexes within the mapping. */
+	size_t next;                /* Page a sequential reader needs next. */
+	size_t ra_start;            /* First page of the last readahead. */
+	size_t ra_size;             /* Pages in it, or 0 if none. */
+};
+
+/* Writeback tunables, set from the kernel command line. */
+extern unsigned vm_writeback_interval;
+extern unsigned vm_dirty_background_ratio;
+extern unsigned vm_dirty_ratio;
+
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+struct page *file_map_copy (struct page *src);
+
+struct mmap_region *mmap_region_copy (const struct mmap_region *);
+void mmap_region_add_page (struct mmap_region *, struct page *);
+void mmap_region_put (struct mmap_region *);
+void mmap_access (struct page *page, bool resident);
+void file_writeback (unsigned ratio);
 #endif
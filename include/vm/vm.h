@@ -1,6 +1,10 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <list.h>
+#include <rhash.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -45,7 +49,10 @@ struct page {
 	void *va;              /* Address in terms of user space */
 	struct frame *frame;   /* Back reference for frame */
 
-	/* Your implementation */
+	bool writable;         /* Writable by the user process? */
+	struct list_elem frame_elem; /* Element in the frame's `pages'. */
+	uint64_t *pml4;        /* Page table of the owning process. */
+	struct mmap_region *mmap; /* Its mmap() mapping, or null. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,10 +66,22 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ *
+ * After fork, a frame is shared copy-on-write by the parent's and
+ * the child's pages, all mapped read-only, until one of them
+ * writes.  Every member but `kva' is protected by the frame lock
+ * in vm.c. */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct page *page;          /* One of the pages in `pages'. */
+	struct list pages;          /* Pages sharing this frame. */
+	unsigned ref_cnt;           /* Number of pages in `pages'. */
+	struct list_elem table_elem; /* Element in the frame table. */
+	bool pinned;                /* Not to be evicted? */
+	size_t swap_slot;           /* Swap slot it caches, or SWAP_SLOT_NONE. */
+	struct rhash_elem swap_elem; /* Element in the swap cache. */
+	bool dirty_seen;            /* File page dirty at the last writeback? */
 };
 
 /* The function table for page operations.
@@ -81,12 +100,36 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* Where the contents of a lazily loaded page come from: READ_BYTES
+ * bytes of FILE starting at OFS, followed by zeros up to the end of
+ * the page.  FILE is the page's own reopened handle.  This is the
+ * aux of every uninit page that is not simply zero-filled. */
+struct page_load {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+};
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ *
+ * A radix tree keyed by virtual page number, shaped like the x86-64
+ * page table: four levels of 512-entry nodes, one page each, indexed
+ * by the PML4, PDPE, PDX and PTX fields of the address.  Leaf
+ * entries point to struct pages.  Each interior entry holds the
+ * page-aligned address of its child node with the child's number of
+ * nonempty entries in the low 12 bits, so that a node can be freed
+ * as soon as it empties.  Lookup takes four loads, and walking a
+ * range skips empty subtrees wholesale. */
 struct supplemental_page_table {
+	uint64_t *root;             /* Top-level node, or null. */
+	size_t page_cnt;            /* Number of pages. */
+	int walk_depth;             /* Nesting of spt_for_each() calls. */
 };
 
+/* Called by spt_for_each() for each page in a range.  Returns false
+ * to stop the walk. */
+typedef bool spt_action_func (struct page *, void *aux);
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -96,8 +139,20 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+bool spt_for_each (struct supplemental_page_table *spt, void *start, void *end,
+		spt_action_func *action, void *aux);
+
+struct page_load *page_load_create (struct file *file, off_t ofs,
+		size_t read_bytes);
+struct page_load *page_load_copy (const struct page_load *);
+bool page_load_read (const struct page_load *, void *kva);
+void page_load_free (struct page_load *);
+
+extern size_t vm_fault_around;
+extern bool vm_fault_stats;
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -106,6 +161,10 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+bool vm_prefetch_begin (struct page *page);
+void vm_prefetch_end (struct page *page, bool success);
+size_t vm_writeback_begin (struct page *pages[], size_t max, unsigned ratio);
+void vm_writeback_end (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
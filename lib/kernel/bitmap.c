@@ -55,6 +55,56 @@ byte_cnt (size_t bit_cnt) {
 	return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns a bit mask in which the bits of the element containing
+   bit START that fall in [START, END) are set to 1 and the rest
+   are set to 0.  END must be greater than START and at most the
+   index just past that element. */
+static inline elem_type
+range_mask (size_t start, size_t end) {
+	elem_type mask = (elem_type) -1 << (start % ELEM_BITS);
+	if (end % ELEM_BITS != 0 && elem_idx (end) == elem_idx (start))
+		mask &= ((elem_type) 1 << (end % ELEM_BITS)) - 1;
+	return mask;
+}
+
+/* Returns the number of 1 bits in X.  (__builtin_popcountl would
+   need libgcc, which the kernel does not link, on CPUs without the
+   POPCNT instruction.) */
+static inline size_t
+popcount (elem_type x) {
+	x = x - ((x >> 1) & 0x5555555555555555UL);
+	x = (x & 0x3333333333333333UL) + ((x >> 2) & 0x3333333333333333UL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (x * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B between START and END,
+   exclusive, that is set to VALUE, or END if there is none.  END
+   must be at most B's size.  Whole elements that hold no such bit
+   are skipped at once, and no element past END is looked at. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value) {
+	size_t idx = elem_idx (start);
+	size_t last = elem_cnt (end);
+	elem_type e;
+
+	ASSERT (end <= b->bit_cnt);
+
+	if (start >= end)
+		return end;
+
+	e = value ? b->bits[idx] : ~b->bits[idx];
+	e &= (elem_type) -1 << (start % ELEM_BITS);
+	while (e == 0) {
+		if (++idx >= last)
+			return end;
+		e = value ? b->bits[idx] : ~b->bits[idx];
+	}
+
+	start = idx * ELEM_BITS + __builtin_ctzl (e);
+	return start < end ? start : end;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -194,17 +244,30 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each
+   element is updated atomically, as by bitmap_set(). */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	while (start < end) {
+		size_t idx = elem_idx (start);
+		size_t next = (idx + 1) * ELEM_BITS;
+		elem_type mask;
+
+		if (next > end)
+			next = end;
+		mask = range_mask (start, next);
+		if (value)
+			asm ("lock orq %1, %0" : "+m" (b->bits[idx]) : "r" (mask) : "cc");
+		else
+			asm ("lock andq %1, %0" : "+m" (b->bits[idx]) : "r" (~mask) : "cc");
+		start = next;
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -218,26 +281,27 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
-	return value_cnt;
+	for (i = start; i < start + cnt; ) {
+		size_t idx = elem_idx (i);
+		size_t next = (idx + 1) * ELEM_BITS;
+
+		if (next > start + cnt)
+			next = start + cnt;
+		value_cnt += popcount (b->bits[idx] & range_mask (i, next));
+		i = next;
+	}
+	return value ? value_cnt : cnt - value_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return cnt > 0 && find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -272,12 +336,21 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
+		size_t i = start;
+
+		/* Jump from each VALUE bit to the end of its run, looking
+		   no further than CNT bits; stop at the first run that is
+		   long enough. */
+		while ((i = find_next (b, i, last + 1, value)) <= last) {
+			size_t run_end = find_next (b, i, i + cnt, !value);
+			if (run_end - i >= cnt)
 				return i;
+			i = run_end;
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -0,0 +1,141 @@
+/* Pairing heap.
+
+   See heap.h for basic information, and "The Pairing Heap: A
+   New Form of Self-Adjusting Heap" by Fredman, Sedgewick,
+   Sleator and Tarjan for the data structure. */
+
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *link (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes H as an empty heap that compares elements using
+   LESS, given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) {
+	ASSERT (h != NULL);
+	ASSERT (less != NULL);
+
+	h->root = NULL;
+	h->less = less;
+	h->aux = aux;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h) {
+	return h->root == NULL;
+}
+
+/* Returns the greatest element in H, which must not be empty.
+   If several elements are greatest, returns any one of them. */
+struct heap_elem *
+heap_max (const struct heap *h) {
+	ASSERT (!heap_empty (h));
+	return h->root;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e) {
+	ASSERT (e != NULL);
+
+	e->child = e->next = e->prev = NULL;
+	h->root = h->root != NULL ? link (h, h->root, e) : e;
+}
+
+/* Removes and returns the greatest element in H, which must not
+   be empty. */
+struct heap_elem *
+heap_pop (struct heap *h) {
+	struct heap_elem *max = heap_max (h);
+
+	h->root = merge_pairs (h, max->child);
+	return max;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) {
+	struct heap_elem *sub;
+
+	if (e == h->root) {
+		heap_pop (h);
+		return;
+	}
+
+	/* Unlink E and its subtree from its parent's children. */
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+
+	/* Put E's children back as a tree of their own. */
+	sub = merge_pairs (h, e->child);
+	if (sub != NULL)
+		h->root = link (h, h->root, sub);
+}
+
+/* Merges the trees rooted at A and B, neither of which may have
+   siblings, and returns the root of the result. */
+static struct heap_elem *
+link (struct heap *h, struct heap_elem *a, struct heap_elem *b) {
+	if (h->less (a, b, h->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* B becomes A's first child. */
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	b->prev = a;
+	a->child = b;
+	return a;
+}
+
+/* Merges the sibling list starting at FIRST into a single tree
+   and returns its root, or a null pointer if FIRST is null.
+   Siblings are linked in pairs from left to right, and the pairs
+   are then merged from right to left. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass.  Pushes each pair's tree on the PAIRS stack,
+	   linked through `next', so the rightmost pair ends on top. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		if (b != NULL) {
+			first = b->next;
+			b->prev = b->next = NULL;
+		} else
+			first = NULL;
+		a->prev = a->next = NULL;
+		if (b != NULL)
+			a = link (h, a, b);
+
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Second pass. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+
+		pairs->next = NULL;
+		root = root != NULL ? link (h, root, pairs) : pairs;
+		pairs = next;
+	}
+	if (root != NULL)
+		root->prev = NULL;
+	return root;
+}
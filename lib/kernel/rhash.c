@@ -0,0 +1,443 @@
+/* Open-addressing hash table with incremental resizing.
+
+   See rhash.h for basic information. */
+
+#include "rhash.h"
+#include "../debug.h"
+#include <string.h>
+#include "threads/malloc.h"
+
+/* Smallest number of slots. */
+#define MIN_SLOTS 8
+
+/* Number of old slots migrated by each insertion, lookup, or
+   deletion while a resize is in progress.  With a maximum load
+   of 7/8 this finishes well before the new array fills. */
+#define MIGRATE_CNT 8
+
+static struct rhash_elem *lookup (struct rhash *, struct rhash_elem *);
+static size_t find_slot (struct rhash *, struct rhash_elem **, size_t slot_cnt,
+		size_t skip_start, size_t skip_cnt, struct rhash_elem *);
+static void place_elem (struct rhash_elem **, size_t slot_cnt,
+		struct rhash_elem *);
+static void remove_slot (struct rhash_elem **, size_t slot_cnt, size_t idx);
+static bool insert_elem (struct rhash *, struct rhash_elem *);
+static struct rhash_elem *remove_elem (struct rhash *, struct rhash_elem *);
+static void migrate (struct rhash *, size_t cnt);
+static void resize (struct rhash *, size_t slot_cnt);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+rhash_init (struct rhash *h,
+		rhash_hash_func *hash, rhash_less_func *less, void *aux) {
+	h->elem_cnt = 0;
+	h->slot_cnt = MIN_SLOTS;
+	h->slots = calloc (h->slot_cnt, sizeof *h->slots);
+	h->old_slots = NULL;
+	h->old_slot_cnt = 0;
+	h->migrate_start = h->migrate_cnt = 0;
+	h->hash = hash;
+	h->less = less;
+	h->aux = aux;
+
+	return h->slots != NULL;
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while rhash_clear() is running, using any of the
+   functions rhash_clear(), rhash_destroy(), rhash_insert(),
+   rhash_replace(), rhash_find(), or rhash_delete(), yields
+   undefined behavior, whether done in DESTRUCTOR or elsewhere. */
+void
+rhash_clear (struct rhash *h, rhash_action_func *destructor) {
+	if (destructor != NULL)
+		rhash_apply (h, destructor);
+
+	memset (h->slots, 0, sizeof *h->slots * h->slot_cnt);
+	free (h->old_slots);
+	h->old_slots = NULL;
+	h->old_slot_cnt = 0;
+	h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash, as in rhash_clear(). */
+void
+rhash_destroy (struct rhash *h, rhash_action_func *destructor) {
+	if (destructor != NULL)
+		rhash_apply (h, destructor);
+	free (h->slots);
+	free (h->old_slots);
+}
+
+/* Inserts NEW into hash table H, if no equal element is already
+   in the table.  If OLD is non-null, stores in *OLD the equal
+   element, which is left in place of NEW, or a null pointer.
+   Returns false, without inserting NEW, only if H is full and
+   memory is too short to grow it. */
+bool
+rhash_insert (struct rhash *h, struct rhash_elem *new,
+		struct rhash_elem **old) {
+	struct rhash_elem *found = lookup (h, new);
+
+	if (old != NULL)
+		*old = found;
+	return found != NULL || insert_elem (h, new);
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table.  If OLD is non-null, stores in *OLD the
+   element replaced, or a null pointer.  Returns false, without
+   inserting NEW, only if H is full and memory is too short to
+   grow it; an element that would have been replaced then stays. */
+bool
+rhash_replace (struct rhash *h, struct rhash_elem *new,
+		struct rhash_elem **old) {
+	struct rhash_elem *found = remove_elem (h, new);
+
+	if (old != NULL)
+		*old = found;
+
+	/* Removing an element left room for NEW. */
+	if (found != NULL) {
+		place_elem (h->slots, h->slot_cnt, new);
+		h->elem_cnt++;
+		return true;
+	}
+	return insert_elem (h, new);
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table.  Like
+   the functions that modify H, this may migrate elements of a
+   resize in progress, so it invalidates iterators. */
+struct rhash_elem *
+rhash_find (struct rhash *h, struct rhash_elem *e) {
+	return lookup (h, e);
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct rhash_elem *
+rhash_delete (struct rhash *h, struct rhash_elem *e) {
+	struct rhash_elem *found = remove_elem (h, e);
+
+	/* Shrink when the table is mostly empty, but never on top of
+	   a resize that is still migrating. */
+	if (found != NULL && h->old_slots == NULL
+			&& h->slot_cnt > MIN_SLOTS && h->elem_cnt * 8 < h->slot_cnt)
+		resize (h, h->slot_cnt / 2);
+
+	return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while rhash_apply() is running, using
+   any of the functions rhash_clear(), rhash_destroy(),
+   rhash_insert(), rhash_replace(), rhash_find(), or
+   rhash_delete(), yields undefined behavior, whether done from
+   ACTION or elsewhere. */
+void
+rhash_apply (struct rhash *h, rhash_action_func *action) {
+	size_t i;
+
+	ASSERT (action != NULL);
+
+	for (i = 0; i < h->old_slot_cnt; i++)
+		if (h->old_slots[i] != NULL)
+			action (h->old_slots[i], h->aux);
+	for (i = 0; i < h->slot_cnt; i++)
+		if (h->slots[i] != NULL)
+			action (h->slots[i], h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+   struct rhash_iterator i;
+
+   rhash_first (&i, h);
+   while (rhash_next (&i))
+   {
+   struct foo *f = rhash_entry (rhash_cur (&i), struct foo, elem);
+   ...do something with f...
+   }
+
+   Modifying hash table H during iteration, using any of the
+   functions rhash_clear(), rhash_destroy(), rhash_insert(),
+   rhash_replace(), rhash_find(), or rhash_delete(), invalidates
+   all iterators. */
+void
+rhash_first (struct rhash_iterator *i, struct rhash *h) {
+	ASSERT (i != NULL);
+	ASSERT (h != NULL);
+
+	i->hash = h;
+	i->in_old = h->old_slots != NULL;
+	i->pos = 0;
+	i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct rhash_elem *
+rhash_next (struct rhash_iterator *i) {
+	struct rhash *h;
+
+	ASSERT (i != NULL);
+
+	h = i->hash;
+	for (;;) {
+		struct rhash_elem **slots = i->in_old ? h->old_slots : h->slots;
+		size_t slot_cnt = i->in_old ? h->old_slot_cnt : h->slot_cnt;
+
+		while (i->pos < slot_cnt)
+			if ((i->elem = slots[i->pos++]) != NULL)
+				return i->elem;
+		if (!i->in_old)
+			return i->elem = NULL;
+		i->in_old = false;
+		i->pos = 0;
+	}
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling rhash_first() but before rhash_next(). */
+struct rhash_elem *
+rhash_cur (struct rhash_iterator *i) {
+	return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+rhash_size (struct rhash *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+rhash_empty (struct rhash *h) {
+	return h->elem_cnt == 0;
+}
+
+/* Returns how far slot IDX, in an array of SLOT_CNT slots, is
+   from the home slot of E. */
+static inline size_t
+probe_dist (const struct rhash_elem *e, size_t idx, size_t slot_cnt) {
+	return (idx - e->hash) & (slot_cnt - 1);
+}
+
+/* Computes E's hash, does a step of any resize in progress, and
+   returns the element in H equal to E, or a null pointer. */
+static struct rhash_elem *
+lookup (struct rhash *h, struct rhash_elem *e) {
+	size_t idx;
+
+	e->hash = h->hash (e, h->aux);
+	migrate (h, MIGRATE_CNT);
+
+	if (h->old_slots != NULL) {
+		idx = find_slot (h, h->old_slots, h->old_slot_cnt,
+				h->migrate_start, h->migrate_cnt, e);
+		if (idx != SIZE_MAX)
+			return h->old_slots[idx];
+	}
+	idx = find_slot (h, h->slots, h->slot_cnt, 0, 0, e);
+	return idx != SIZE_MAX ? h->slots[idx] : NULL;
+}
+
+/* Searches SLOTS, an array of SLOT_CNT slots in H, for an element
+   equal to E, whose hash must be set.  The SKIP_CNT slots from
+   SKIP_START on, wrapping around, have been migrated and are
+   empty; a probe that starts among them resumes just past them.
+   Returns the index of the element, or SIZE_MAX if there is
+   none. */
+static size_t
+find_slot (struct rhash *h, struct rhash_elem **slots, size_t slot_cnt,
+		size_t skip_start, size_t skip_cnt, struct rhash_elem *e) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = e->hash & mask;
+	size_t dist = 0;
+
+	if (((idx - skip_start) & mask) < skip_cnt) {
+		dist = skip_cnt - ((idx - skip_start) & mask);
+		idx = (skip_start + skip_cnt) & mask;
+	}
+
+	/* An element closer to its home than we are to ours means E
+	   would have taken its slot, so E is not here. */
+	for (; dist < slot_cnt; dist++, idx = (idx + 1) & mask) {
+		struct rhash_elem *cur = slots[idx];
+
+		if (cur == NULL || probe_dist (cur, idx, slot_cnt) < dist)
+			break;
+		if (cur->hash == e->hash
+				&& !h->less (cur, e, h->aux) && !h->less (e, cur, h->aux))
+			return idx;
+	}
+	return SIZE_MAX;
+}
+
+/* Puts E, whose hash is set, into SLOTS, an array of SLOT_CNT
+   slots with at least one empty.  E displaces the first element
+   that is closer to its home than E is to its own, which then
+   continues the probe in E's place. */
+static void
+place_elem (struct rhash_elem **slots, size_t slot_cnt,
+		struct rhash_elem *e) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = e->hash & mask;
+	size_t dist = 0;
+
+	for (;; dist++, idx = (idx + 1) & mask) {
+		struct rhash_elem *cur = slots[idx];
+		size_t cur_dist;
+
+		if (cur == NULL) {
+			slots[idx] = e;
+			return;
+		}
+		cur_dist = probe_dist (cur, idx, slot_cnt);
+		if (cur_dist < dist) {
+			slots[idx] = e;
+			e = cur;
+			dist = cur_dist;
+		}
+	}
+}
+
+/* Empties slot IDX in SLOTS, an array of SLOT_CNT slots, and
+   shifts the elements after it that are away from their home
+   slots back by one, so no probe sequence has a hole. */
+static void
+remove_slot (struct rhash_elem **slots, size_t slot_cnt, size_t idx) {
+	size_t mask = slot_cnt - 1;
+
+	for (;;) {
+		size_t next = (idx + 1) & mask;
+		struct rhash_elem *e = slots[next];
+
+		if (e == NULL || probe_dist (e, next, slot_cnt) == 0) {
+			slots[idx] = NULL;
+			return;
+		}
+		slots[idx] = e;
+		idx = next;
+	}
+}
+
+/* Inserts E, whose hash is set, into H, growing H first if that
+   would leave it more than 7/8 full.  If H cannot grow, it still
+   takes E while the current array keeps room for every element
+   once migration is done, plus an empty slot.  Returns false if
+   it does not. */
+static bool
+insert_elem (struct rhash *h, struct rhash_elem *e) {
+	if ((h->elem_cnt + 1) * 8 > h->slot_cnt * 7)
+		resize (h, h->slot_cnt * 2);
+	if (h->elem_cnt + 1 >= h->slot_cnt)
+		return false;
+
+	place_elem (h->slots, h->slot_cnt, e);
+	h->elem_cnt++;
+	return true;
+}
+
+/* Removes and returns the element in H equal to E, or returns a
+   null pointer if there is none. */
+static struct rhash_elem *
+remove_elem (struct rhash *h, struct rhash_elem *e) {
+	struct rhash_elem *found = NULL;
+	size_t idx;
+
+	e->hash = h->hash (e, h->aux);
+	migrate (h, MIGRATE_CNT);
+
+	if (h->old_slots != NULL) {
+		idx = find_slot (h, h->old_slots, h->old_slot_cnt,
+				h->migrate_start, h->migrate_cnt, e);
+		if (idx != SIZE_MAX) {
+			found = h->old_slots[idx];
+			remove_slot (h->old_slots, h->old_slot_cnt, idx);
+		}
+	}
+	if (found == NULL) {
+		idx = find_slot (h, h->slots, h->slot_cnt, 0, 0, e);
+		if (idx != SIZE_MAX) {
+			found = h->slots[idx];
+			remove_slot (h->slots, h->slot_cnt, idx);
+		}
+	}
+
+	if (found != NULL)
+		h->elem_cnt--;
+	return found;
+}
+
+/* Moves up to CNT of H's old slots into the current array, and
+   frees the old array once every slot has been moved.  Old
+   slots are taken in order from migrate_start, which was empty
+   when the resize began, so no probe sequence among the slots
+   not yet moved runs through one that has been. */
+static void
+migrate (struct rhash *h, size_t cnt) {
+	while (h->old_slots != NULL && cnt-- > 0) {
+		size_t idx = (h->migrate_start + h->migrate_cnt)
+			& (h->old_slot_cnt - 1);
+		struct rhash_elem *e = h->old_slots[idx];
+
+		if (e != NULL) {
+			h->old_slots[idx] = NULL;
+			place_elem (h->slots, h->slot_cnt, e);
+		}
+		if (++h->migrate_cnt == h->old_slot_cnt) {
+			free (h->old_slots);
+			h->old_slots = NULL;
+			h->old_slot_cnt = 0;
+		}
+	}
+}
+
+/* Starts moving H to a new array of SLOT_CNT slots.  A resize
+   still in progress is finished first.  This function can fail
+   because of an out-of-memory condition, but that'll just make
+   hash accesses less efficient; we can still continue. */
+static void
+resize (struct rhash *h, size_t slot_cnt) {
+	struct rhash_elem **slots;
+	size_t i;
+
+	migrate (h, SIZE_MAX);
+
+	slots = calloc (slot_cnt, sizeof *slots);
+	if (slots == NULL)
+		return;
+
+	h->old_slots = h->slots;
+	h->old_slot_cnt = h->slot_cnt;
+	h->slots = slots;
+	h->slot_cnt = slot_cnt;
+
+	/* There is always an empty slot, since the array is never
+	   allowed to fill up. */
+	for (i = 0; h->old_slots[i] != NULL; i++)
+		continue;
+	h->migrate_start = i;
+	h->migrate_cnt = 0;
+}
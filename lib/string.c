@@ -1,5 +1,17 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below handle a block of WORD_MIN bytes or
+   more a 64-bit word at a time.  They first step bytewise until
+   the destination is word-aligned, then move whole words (using
+   the string instructions where they go upward), and finish the
+   last few bytes bytewise.  Smaller blocks are not worth the
+   setup.  Nothing here touches the SSE registers, which the
+   kernel does not save. */
+typedef uint64_t __attribute__ ((__may_alias__)) word_t;
+#define WORD_SIZE sizeof (word_t)
+#define WORD_MIN 32
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,6 +23,19 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
+	if (size >= WORD_MIN) {
+		size_t head = -(uintptr_t) dst % WORD_SIZE;
+		size_t words;
+
+		size -= head;
+		while (head-- > 0)
+			*dst++ = *src++;
+
+		words = size / WORD_SIZE;
+		size %= WORD_SIZE;
+		asm volatile ("rep movsq"
+				: "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+	}
 	while (size-- > 0)
 		*dst++ = *src++;
 
@@ -28,16 +53,29 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (src != NULL || size == 0);
 
 	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
+		/* Copying upward never overwrites a source byte before
+		   it is read, even a word at a time. */
+		return memcpy (dst_, src_, size);
+	}
+
+	dst += size;
+	src += size;
+	if (size >= WORD_MIN) {
+		size_t tail = (uintptr_t) dst % WORD_SIZE;
+
+		size -= tail;
+		while (tail-- > 0)
 			*--dst = *--src;
+		for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+			dst -= WORD_SIZE;
+			src -= WORD_SIZE;
+			*(word_t *) dst = *(const word_t *) src;
+		}
 	}
+	while (size-- > 0)
+		*--dst = *--src;
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +90,14 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip equal words, leaving the first unequal one, if any,
+	   to the byte loop. */
+	for (; size >= WORD_SIZE; size -= WORD_SIZE) {
+		if (*(const word_t *) a != *(const word_t *) b)
+			break;
+		a += WORD_SIZE;
+		b += WORD_SIZE;
+	}
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -260,6 +306,20 @@ memset (void *dst_, int value, size_t size) {
 
 	ASSERT (dst != NULL || size == 0);
 
+	if (size >= WORD_MIN) {
+		size_t head = -(uintptr_t) dst % WORD_SIZE;
+		uint64_t word = (unsigned char) value * 0x0101010101010101ULL;
+		size_t words;
+
+		size -= head;
+		while (head-- > 0)
+			*dst++ = value;
+
+		words = size / WORD_SIZE;
+		size %= WORD_SIZE;
+		asm volatile ("rep stosq"
+				: "+D" (dst), "+c" (words) : "a" (word) : "memory");
+	}
 	while (size-- > 0)
 		*dst++ = value;
 
@@ -0,0 +1,179 @@
+/* Checks memcpy(), memmove(), memset() and memcmp() against
+   simple byte loops over a range of sizes and alignments, then
+   reports the throughput of each on page-sized and larger blocks
+   in bytes per cycle, next to that of a byte loop. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+#define BUF_PAGES 32                    /* Pages per buffer. */
+#define BUF_SIZE (BUF_PAGES * 4096)     /* Bytes per buffer. */
+#define ROUND_CNT 8                     /* Timed runs per size. */
+
+static unsigned char *a, *b, *c;
+
+/* Operations timed by bench(), by number. */
+static const char *op_names[] =
+  {"memcpy", "memmove", "memset", "memcmp", "byte loop"};
+#define OP_CNT (sizeof op_names / sizeof *op_names)
+
+static void check_all (void);
+static void bench (size_t size, size_t op);
+static uint64_t rdtsc (void);
+
+void
+test_mem_bench (void) 
+{
+  size_t sizes[] = {64, 4096, BUF_SIZE};
+  size_t i, op;
+
+  a = palloc_get_multiple (PAL_ASSERT, BUF_PAGES);
+  b = palloc_get_multiple (PAL_ASSERT, BUF_PAGES);
+  c = palloc_get_multiple (PAL_ASSERT, BUF_PAGES);
+
+  check_all ();
+  msg ("results match byte loops");
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    for (op = 0; op < OP_CNT; op++)
+      bench (sizes[i], op);
+
+  palloc_free_multiple (a, BUF_PAGES);
+  palloc_free_multiple (b, BUF_PAGES);
+  palloc_free_multiple (c, BUF_PAGES);
+  pass ();
+}
+
+/* Fills A with a pattern that differs from B's. */
+static void
+fill (void) 
+{
+  size_t i;
+
+  for (i = 0; i < 4096; i++)
+    {
+      a[i] = i * 7 + 1;
+      b[i] = c[i] = i * 13 + 5;
+    }
+}
+
+/* Compares the word-wise functions with byte loops for every
+   size up to 100 bytes and a few larger ones, at every pair of
+   misalignments. */
+static void
+check_all (void) 
+{
+  size_t sizes[] = {0, 1, 7, 8, 31, 32, 33, 63, 100, 1000, 2047};
+  size_t i, s, d, k;
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    for (s = 0; s < 8; s++)
+      for (d = 0; d < 8; d++)
+        {
+          size_t n = sizes[i];
+
+          /* memcpy. */
+          fill ();
+          memcpy (b + d, a + s, n);
+          for (k = 0; k < n; k++)
+            c[d + k] = a[s + k];
+          if (memcmp (b, c, 4096))
+            fail ("memcpy of %zu bytes from +%zu to +%zu", n, s, d);
+
+          /* memmove, both directions over one buffer. */
+          fill ();
+          memmove (b + d, b + s + 16, n);
+          for (k = 0; k < n; k++)
+            c[d + k] = c[s + 16 + k];
+          if (memcmp (b, c, 4096))
+            fail ("memmove down of %zu bytes from +%zu to +%zu", n, s, d);
+          fill ();
+          memmove (b + d + 16, b + s, n);
+          for (k = n; k-- > 0; )
+            c[d + 16 + k] = c[s + k];
+          if (memcmp (b, c, 4096))
+            fail ("memmove up of %zu bytes from +%zu to +%zu", n, s, d);
+
+          /* memset. */
+          fill ();
+          memset (b + d, 0xa5, n);
+          for (k = 0; k < n; k++)
+            c[d + k] = 0xa5;
+          if (memcmp (b, c, 4096))
+            fail ("memset of %zu bytes at +%zu", n, d);
+
+          /* memcmp, equal and with the last byte raised. */
+          memcpy (a + s, b + d, n);
+          if (memcmp (a + s, b + d, n) != 0)
+            fail ("memcmp of %zu equal bytes", n);
+          if (n > 0)
+            {
+              a[s + n - 1]++;
+              if (memcmp (a + s, b + d, n) <= 0
+                  || memcmp (b + d, a + s, n) >= 0)
+                fail ("memcmp of %zu bytes differing in the last", n);
+            }
+        }
+}
+
+/* Times ROUND_CNT runs of operation OP on SIZE-byte blocks and
+   reports the throughput of the fastest. */
+static void
+bench (size_t size, size_t op) 
+{
+  uint64_t best = UINT64_MAX;
+  int round;
+
+  memset (a, 0x5a, size);
+  memset (b, 0x5a, size);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      uint64_t start = rdtsc ();
+      uint64_t cycles;
+      size_t k;
+
+      switch (op)
+        {
+        case 0:
+          memcpy (a, b, size);
+          break;
+        case 1:
+          memmove (a + 1, a, size - 1);
+          break;
+        case 2:
+          memset (a, 0x5a, size);
+          break;
+        case 3:
+          if (memcmp (a, b, size) != 0)
+            fail ("memcmp of equal blocks");
+          break;
+        default:
+          for (k = 0; k < size; k++)
+            ((volatile unsigned char *) a)[k] = b[k];
+          break;
+        }
+      cycles = rdtsc () - start;
+      if (cycles > 0 && cycles < best)
+        best = cycles;
+    }
+
+  if (best == UINT64_MAX)
+    best = 1;
+  msg ("%s, %zu bytes: %llu.%02llu bytes/cycle", op_names[op], size,
+       (unsigned long long) (size / best),
+       (unsigned long long) (size * 100 / best % 100));
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void) 
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
@@ -0,0 +1,183 @@
+/* Checks the open-addressing hash table in lib/kernel/rhash.c.
+
+   Inserts enough elements, in random order, to make the table grow
+   several times, and deletes most of them again so that it
+   shrinks, checking after each step that every element that should
+   be found is found and no other.  Lookups during a resize must see
+   elements in both the old and the new slot arrays.  Runs once with
+   a good hash function and once with one that gives only 64
+   distinct values, so that probe sequences get long. */
+
+#include <random.h>
+#include <rhash.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+
+#define VALUE_CNT 1024
+
+struct value
+  {
+    struct rhash_elem elem;     /* Hash table element. */
+    int key;                    /* Key. */
+    bool in;                    /* In the table? */
+  };
+
+static struct value values[VALUE_CNT];
+
+static rhash_hash_func good_hash, bad_hash;
+static rhash_less_func value_less;
+static void run (rhash_hash_func *, const char *);
+static void shuffle (int *, size_t);
+static void check (struct rhash *, const char *);
+
+void
+test_rhash (void)
+{
+  random_init (0);
+  run (good_hash, "good hash");
+  run (bad_hash, "bad hash");
+  pass ();
+}
+
+/* Inserts and deletes every value in H, hashed by HASH. */
+static void
+run (rhash_hash_func *hash, const char *name)
+{
+  static int order[VALUE_CNT];
+  struct rhash h;
+  struct rhash_elem *old;
+  struct value dup;
+  size_t i;
+
+  if (!rhash_init (&h, hash, value_less, NULL))
+    fail ("%s: rhash_init failed", name);
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      values[i].key = i;
+      values[i].in = false;
+      order[i] = i;
+    }
+
+  /* Insert in random order, checking as the table grows. */
+  shuffle (order, VALUE_CNT);
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      struct value *v = &values[order[i]];
+
+      if (!rhash_insert (&h, &v->elem, &old) || old != NULL)
+        fail ("%s: inserting %d failed", name, v->key);
+      v->in = true;
+      if (i % 61 == 0)
+        check (&h, name);
+    }
+  check (&h, name);
+
+  /* An equal element is found, not inserted. */
+  dup.key = order[0];
+  if (!rhash_insert (&h, &dup.elem, &old) || old != &values[order[0]].elem)
+    fail ("%s: duplicate %d was not found", name, dup.key);
+
+  /* Replacing puts the new element in place of the old one. */
+  if (!rhash_replace (&h, &dup.elem, &old) || old != &values[order[0]].elem
+      || rhash_find (&h, &values[order[0]].elem) != &dup.elem)
+    fail ("%s: replacing %d failed", name, dup.key);
+  if (!rhash_replace (&h, &values[order[0]].elem, &old) || old != &dup.elem)
+    fail ("%s: replacing %d back failed", name, dup.key);
+  check (&h, name);
+
+  /* Delete all but a few, in another random order, checking as
+     the table shrinks. */
+  shuffle (order, VALUE_CNT);
+  for (i = 0; i < VALUE_CNT - 8; i++)
+    {
+      struct value *v = &values[order[i]];
+
+      if (rhash_delete (&h, &v->elem) != &v->elem)
+        fail ("%s: deleting %d failed", name, v->key);
+      v->in = false;
+      if (rhash_delete (&h, &v->elem) != NULL)
+        fail ("%s: %d deleted twice", name, v->key);
+      if (i % 61 == 0)
+        check (&h, name);
+    }
+  check (&h, name);
+
+  rhash_clear (&h, NULL);
+  for (i = 0; i < VALUE_CNT; i++)
+    values[i].in = false;
+  check (&h, name);
+  rhash_destroy (&h, NULL);
+  msg ("%s: ok", name);
+}
+
+/* Checks that H holds exactly the values marked as in it. */
+static void
+check (struct rhash *h, const char *name)
+{
+  struct rhash_iterator it;
+  size_t i, in_cnt = 0, seen_cnt = 0;
+
+  /* Iterate first: lookups may migrate elements, which would
+     invalidate the iterator. */
+  rhash_first (&it, h);
+  while (rhash_next (&it))
+    {
+      struct value *v = rhash_entry (rhash_cur (&it), struct value, elem);
+      if (!v->in)
+        fail ("%s: iteration found %d, which is not in the table",
+              name, v->key);
+      seen_cnt++;
+    }
+
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      struct value *v = &values[i];
+      struct rhash_elem *e = rhash_find (h, &v->elem);
+
+      if (v->in)
+        in_cnt++;
+      if (e != (v->in ? &v->elem : NULL))
+        fail ("%s: looking up %d found %p", name, v->key, e);
+    }
+  if (rhash_size (h) != in_cnt || seen_cnt != in_cnt)
+    fail ("%s: size %zu and %zu iterated, but %zu in the table",
+          name, rhash_size (h), seen_cnt, in_cnt);
+}
+
+/* Shuffles the CNT ints in ARRAY. */
+static void
+shuffle (int *array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      int t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Hashes a value's key well. */
+static uint64_t
+good_hash (const struct rhash_elem *e, void *aux UNUSED)
+{
+  return rhash_entry (e, struct value, elem)->key * 0x9e3779b97f4a7c15ULL;
+}
+
+/* Hashes a value's key to one of 64 values. */
+static uint64_t
+bad_hash (const struct rhash_elem *e, void *aux UNUSED)
+{
+  return rhash_entry (e, struct value, elem)->key % 64;
+}
+
+/* Orders values by key. */
+static bool
+value_less (const struct rhash_elem *a, const struct rhash_elem *b,
+            void *aux UNUSED)
+{
+  return rhash_entry (a, struct value, elem)->key
+         < rhash_entry (b, struct value, elem)->key;
+}
@@ -20,6 +20,8 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -85,7 +87,9 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_init ();
 	paging_init (mem_end);
+	palloc_init_high ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -105,6 +109,7 @@ main (void) {
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	palloc_start ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -221,11 +226,27 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-lockprof"))
+			lock_profile = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-fault-around"))
+			vm_fault_around = atoi (value) > 0 ? atoi (value) : 1;
+		else if (!strcmp (name, "-fault-stats"))
+			vm_fault_stats = true;
+		else if (!strcmp (name, "-wb-interval"))
+			vm_writeback_interval = atoi (value) > 0 ? atoi (value) : 0;
+		else if (!strcmp (name, "-dirty-bg-ratio"))
+			vm_dirty_background_ratio = atoi (value) > 0 ? atoi (value) : 0;
+		else if (!strcmp (name, "-dirty-ratio"))
+			vm_dirty_ratio = atoi (value) > 0 ? atoi (value) : 0;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -326,8 +347,17 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -lockprof          Profile lock contention by call site.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -fault-around=N    Map up to N pages around each page fault.\n"
+			"  -fault-stats       Print each process's page faults at exit.\n"
+			"  -wb-interval=MS    Write back dirty file pages every MS ms.\n"
+			"  -dirty-bg-ratio=P  Write back all once P%% of frames are dirty.\n"
+			"  -dirty-ratio=P     Make writers write back at P%% dirty, 0 never.\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +384,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	lock_print_stats ();
+	kmem_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +395,7 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +33,16 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor sits a "magazine": a small stack of
+   free blocks of that size, as in Bonwick's magazine layer for
+   the Solaris slab allocator.  malloc() pops from and free()
+   pushes to the magazine with interrupts off, without taking the
+   descriptor's lock.  Only an empty magazine is refilled from,
+   and a full one drained to, the descriptor, MAG_BATCH blocks at
+   a time under its lock.  Blocks in magazines count as in use in
+   their arena. */
 
 /* Descriptor. */
 struct desc {
@@ -58,9 +68,26 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+#define DESC_MAX 10
+static struct desc descs[DESC_MAX]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Cache of free blocks in front of one descriptor. */
+#define MAG_SIZE 16             /* Capacity of a magazine. */
+#define MAG_BATCH (MAG_SIZE / 2) /* Blocks moved per refill or drain. */
+struct magazine {
+	size_t cnt;                 /* Number of blocks in BLOCKS. */
+	struct block *blocks[MAG_SIZE]; /* Free blocks, used as a stack. */
+};
+
+/* magazines[D] belongs to descriptor descs[D]. */
+static struct magazine magazines[DESC_MAX];
+
+static struct magazine *desc_magazine (struct desc *);
+static void *refill_magazine (struct desc *);
+static void drain_magazine (struct desc *, struct block *);
+static void desc_free_block (struct desc *, struct block *);
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -71,7 +98,7 @@ malloc_init (void) {
 
 	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
 		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+		ASSERT (desc_cnt <= DESC_MAX);
 		d->block_size = block_size;
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
@@ -83,6 +110,8 @@ malloc_init (void) {
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	enum intr_level old_level;
+	struct magazine *m;
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -112,6 +141,38 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
+	/* Take a block from D's magazine if it has one. */
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	if (m->cnt > 0) {
+		b = m->blocks[--m->cnt];
+		intr_set_level (old_level);
+		return b;
+	}
+	intr_set_level (old_level);
+
+	return refill_magazine (d);
+}
+
+/* Returns D's magazine.  Interrupts must be off, so that no
+   other thread uses it meanwhile. */
+static struct magazine *
+desc_magazine (struct desc *d) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	return &magazines[d - descs];
+}
+
+/* Moves up to MAG_BATCH blocks from D's free list into D's
+   magazine, creating an arena if the free list is empty, and
+   returns one more block for the caller.  Returns a null pointer
+   if memory is not available. */
+static void *
+refill_magazine (struct desc *d) {
+	enum intr_level old_level;
+	struct magazine *m;
+	struct block *b;
+	struct arena *a;
+
 	lock_acquire (&d->lock);
 
 	/* If the free list is empty, create a new arena. */
@@ -135,10 +196,21 @@ malloc (size_t size) {
 		}
 	}
 
-	/* Get a block from free list and return it. */
+	/* Get a block from free list for the caller, then fill the
+	   magazine. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
+	block_to_arena (b)->free_cnt--;
+
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	while (m->cnt < MAG_BATCH && !list_empty (&d->free_list)) {
+		struct block *mb = list_entry (list_pop_front (&d->free_list),
+				struct block, free_elem);
+		block_to_arena (mb)->free_cnt--;
+		m->blocks[m->cnt++] = mb;
+	}
+	intr_set_level (old_level);
+
 	lock_release (&d->lock);
 	return b;
 }
@@ -207,30 +279,25 @@ free (void *p) {
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			enum intr_level old_level;
+			struct magazine *m;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Put the block in D's magazine if it has room. */
+			old_level = intr_disable ();
+			m = desc_magazine (d);
+			if (m->cnt < MAG_SIZE) {
+				m->blocks[m->cnt++] = b;
+				intr_set_level (old_level);
+				return;
 			}
+			intr_set_level (old_level);
 
-			lock_release (&d->lock);
+			drain_magazine (d, b);
 		} else {
 			/* It's a big block.  Free its pages. */
 			palloc_free_multiple (a, a->free_cnt);
@@ -239,6 +306,53 @@ free (void *p) {
 	}
 }
 
+/* Frees B and up to MAG_BATCH blocks from D's magazine back to
+   D's free list. */
+static void
+drain_magazine (struct desc *d, struct block *b) {
+	struct block *batch[MAG_BATCH];
+	enum intr_level old_level;
+	struct magazine *m;
+	size_t cnt = 0;
+	size_t i;
+
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	while (cnt < MAG_BATCH && m->cnt > 0)
+		batch[cnt++] = m->blocks[--m->cnt];
+	intr_set_level (old_level);
+
+	lock_acquire (&d->lock);
+	desc_free_block (d, b);
+	for (i = 0; i < cnt; i++)
+		desc_free_block (d, batch[i]);
+	lock_release (&d->lock);
+}
+
+/* Returns block B to D's free list, freeing its arena if that
+   leaves the arena entirely unused.  D's lock must be held. */
+static void
+desc_free_block (struct desc *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+
+	/* Add block to free list. */
+	list_push_front (&d->free_list, &b->free_elem);
+
+	/* If the arena is now entirely unused, free it. */
+	if (++a->free_cnt >= d->blocks_per_arena) {
+		size_t i;
+
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_remove (&b->free_elem);
+		}
+		palloc_free_page (a);
+	}
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
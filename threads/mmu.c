@@ -281,7 +281,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
@@ -307,7 +307,7 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
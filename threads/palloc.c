@@ -2,14 +2,17 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +27,54 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  A block of order K is 2**K pages whose index from
+   the pool base is a multiple of 2**K; its buddy is the block of
+   the same order whose index differs only in bit K.  Each order
+   has a free list, threaded through the free blocks themselves.
+   A request for N pages takes a block of the smallest order that
+   holds N, splitting larger blocks as needed, and gives back the
+   unused tail.  Freed blocks merge with their buddies as long as
+   those are free too.  Both take O(log n) time in the pool size.
+
+   Since the free lists are stored in the free pages, a page can
+   only go on them once it is mapped.  palloc_init() runs before
+   paging_init(), so it lists only the pages below LOADER_MAP_END,
+   which start.S maps.  palloc_init_high() lists the rest once the
+   kernel page table covers all of memory.
+
+   A pool is protected by turning interrupts off rather than by a
+   lock, because pages are freed with interrupts off, e.g. by the
+   scheduler when it reaps dying threads.
+
+   Each pool also keeps a small reserve of pages that are already
+   zeroed, so that single-page PAL_ZERO requests (new threads,
+   page tables, anonymous faults) need not clear a page on the
+   spot.  A background kernel thread refills the reserve from the
+   free lists whenever it runs low.  The reserve is still free
+   memory: when the free lists alone cannot satisfy a request, the
+   reserve is given back to them first. */
+
+/* Number of block orders.  The largest block is 2**(ORDER_CNT - 1)
+   pages, which bounds the size of a single allocation. */
+#define ORDER_CNT 16
+
+/* Maximum number of pre-zeroed pages per pool. */
+#define ZERO_MAX 64
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct bitmap *used_map;        /* Bitmap of pages in use. */
+	uint8_t *order_map;             /* 1 + order at free block heads, else 0. */
+	struct list free_lists[ORDER_CNT]; /* Free blocks of each order. */
+	size_t free_cnt;                /* Number of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+
+	void *zeroed[ZERO_MAX];         /* Pre-zeroed free pages. */
+	size_t zeroed_cnt;              /* Number of pages in zeroed[]. */
+	size_t zeroed_max;              /* Size of the reserve to keep. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +82,27 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Page-zeroing thread.  zero_wanted is set by whoever last asked
+   for a refill that the thread has not yet started on.  It starts
+   out set so that no one signals zero_sema before palloc_start()
+   initializes it. */
+static struct semaphore zero_sema;
+static bool zero_wanted = true;
+
+/* Statistics. */
+static long long zero_hit_cnt;          /* PAL_ZERO pages from a reserve. */
+static long long zero_miss_cnt;         /* PAL_ZERO pages cleared on demand. */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void init_free_lists (struct pool *, size_t start, size_t end);
+static size_t boot_mapped_cnt (const struct pool *);
+static size_t alloc_block (struct pool *, size_t order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void release_zeroed (struct pool *);
+static void zero_thread (void *aux);
 
 /* multiboot info */
 struct multiboot_info {
@@ -232,6 +293,9 @@ split:
 			}
 		}
 	}
+
+	init_free_lists (&kernel_pool, 0, boot_mapped_cnt (&kernel_pool));
+	init_free_lists (&user_pool, 0, boot_mapped_cnt (&user_pool));
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -253,6 +317,22 @@ palloc_init (void) {
 	return ext_mem.end;
 }
 
+/* Puts the free pages that palloc_init() could not reach, those
+   at or above LOADER_MAP_END, on the free lists.  Must be called
+   once, after paging_init() has mapped all of memory. */
+void
+palloc_init_high (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	size_t i;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *p = pools[i];
+		enum intr_level old_level = intr_disable ();
+		init_free_lists (p, boot_mapped_cnt (p), bitmap_size (p->used_map));
+		intr_set_level (old_level);
+	}
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
@@ -262,19 +342,58 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
+	size_t page_idx = BITMAP_ERROR;
+	bool zeroed = false;
+	bool refill = false;
+	size_t order = 0;
 	void *pages;
 
+	if (page_cnt == 0)
+		return NULL;
+	while (order < ORDER_CNT && ((size_t) 1 << order) < page_cnt)
+		order++;
+
+	if (order < ORDER_CNT) {
+		old_level = intr_disable ();
+		if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0) {
+			pages = pool->zeroed[--pool->zeroed_cnt];
+			page_idx = pg_no (pages) - pg_no (pool->base);
+			zeroed = true;
+		} else {
+			page_idx = alloc_block (pool, order);
+			if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) {
+				release_zeroed (pool);
+				page_idx = alloc_block (pool, order);
+			}
+			if (page_idx != BITMAP_ERROR)
+				free_range (pool, page_idx + page_cnt,
+						((size_t) 1 << order) - page_cnt);
+		}
+		if (page_idx != BITMAP_ERROR) {
+			bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+			pool->free_cnt -= page_cnt;
+			if (flags & PAL_ZERO) {
+				if (zeroed)
+					zero_hit_cnt++;
+				else
+					zero_miss_cnt += page_cnt;
+			}
+		}
+		refill = pool->zeroed_cnt < pool->zeroed_max / 2;
+		intr_set_level (old_level);
+	}
+
+	if (refill && !__atomic_exchange_n (&zero_wanted, true, __ATOMIC_ACQ_REL))
+		sema_up (&zero_sema);
+
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
 	else
 		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -296,9 +415,25 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
+/* Starts the thread that keeps the pools' reserves of zeroed
+   pages filled.  Must be called after thread_start(). */
+void
+palloc_start (void) {
+	sema_init (&zero_sema, 1);
+	thread_create_background ("pagezero", zero_thread, NULL);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("Pages: %lld zeroed in advance, %lld zeroed on demand\n",
+			zero_hit_cnt, zero_miss_cnt);
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
+	enum intr_level old_level;
 	struct pool *pool;
 	size_t page_idx;
 
@@ -318,8 +453,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+
+	old_level = intr_disable ();
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	free_range (pool, page_idx, page_cnt);
+	pool->free_cnt += page_cnt;
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -335,11 +475,19 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
-
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	size_t bm_size = bitmap_buf_size (pgcnt);
+	size_t bm_pages = DIV_ROUND_UP (bm_size + pgcnt, PGSIZE) * PGSIZE;
+	size_t order;
+
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_size);
+	p->order_map = (uint8_t *) *bm_base + bm_size;
+	memset (p->order_map, 0, pgcnt);
+	for (order = 0; order < ORDER_CNT; order++)
+		list_init (&p->free_lists[order]);
+	p->free_cnt = 0;
 	p->base = (void *) start;
+	p->zeroed_cnt = 0;
+	p->zeroed_max = pgcnt / 16 < ZERO_MAX ? pgcnt / 16 : ZERO_MAX;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
@@ -356,3 +504,174 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Puts the pages with index in [START, END) in P that
+   populate_pools() marked free in its used_map on P's free lists.
+   The pages must be mapped. */
+static void
+init_free_lists (struct pool *p, size_t start, size_t end) {
+	while (start < end) {
+		size_t free_end;
+
+		start = bitmap_scan (p->used_map, start, 1, false);
+		if (start == BITMAP_ERROR || start >= end)
+			break;
+		free_end = bitmap_scan (p->used_map, start, 1, true);
+		if (free_end == BITMAP_ERROR || free_end > end)
+			free_end = end;
+
+		free_range (p, start, free_end - start);
+		p->free_cnt += free_end - start;
+		start = free_end;
+	}
+}
+
+/* Returns the number of pages at the start of P that lie below
+   LOADER_MAP_END, and so are mapped before paging_init(). */
+static size_t
+boot_mapped_cnt (const struct pool *p) {
+	uint64_t limit = (uint64_t) ptov (LOADER_MAP_END);
+	size_t pgcnt = bitmap_size (p->used_map);
+
+	if ((uint64_t) p->base >= limit)
+		return 0;
+	if ((limit - (uint64_t) p->base) / PGSIZE < pgcnt)
+		return (limit - (uint64_t) p->base) / PGSIZE;
+	return pgcnt;
+}
+
+/* Returns the list element stored in the first page of the free
+   block at PAGE_IDX in P. */
+static struct list_elem *
+block_elem (const struct pool *p, size_t page_idx) {
+	return (struct list_elem *) (p->base + PGSIZE * page_idx);
+}
+
+/* Puts the block of ORDER at PAGE_IDX on P's free list. */
+static void
+push_block (struct pool *p, size_t page_idx, size_t order) {
+	p->order_map[page_idx] = order + 1;
+	list_push_front (&p->free_lists[order], block_elem (p, page_idx));
+}
+
+/* Takes the free block at PAGE_IDX off P's free list. */
+static void
+remove_block (struct pool *p, size_t page_idx) {
+	p->order_map[page_idx] = 0;
+	list_remove (block_elem (p, page_idx));
+}
+
+/* Removes a block of 2**ORDER pages from P's free lists, splitting
+   a larger block if no block of ORDER is free, and returns the
+   index of its first page.  Returns BITMAP_ERROR if no block is
+   large enough.  Interrupts must be off. */
+static size_t
+alloc_block (struct pool *p, size_t order) {
+	size_t page_idx;
+	size_t k;
+
+	for (k = order; k < ORDER_CNT; k++)
+		if (!list_empty (&p->free_lists[k]))
+			break;
+	if (k == ORDER_CNT)
+		return BITMAP_ERROR;
+
+	page_idx = pg_no (list_front (&p->free_lists[k])) - pg_no (p->base);
+	remove_block (p, page_idx);
+
+	/* Give back the upper half until the block is the right size. */
+	while (k > order) {
+		k--;
+		push_block (p, page_idx + ((size_t) 1 << k), k);
+	}
+	return page_idx;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in P, merging it
+   with its buddy for as long as the buddy is free as a whole. */
+static void
+free_block (struct pool *p, size_t page_idx, size_t order) {
+	size_t pgcnt = bitmap_size (p->used_map);
+
+	while (order + 1 < ORDER_CNT) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+		if (buddy >= pgcnt || p->order_map[buddy] != order + 1)
+			break;
+		remove_block (p, buddy);
+		page_idx &= ~((size_t) 1 << order);
+		order++;
+	}
+	push_block (p, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in P, which need
+   not form a single block, by splitting them into the largest
+   aligned blocks that fit.  Interrupts must be off, unless P is
+   still being initialized. */
+static void
+free_range (struct pool *p, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		size_t order = 0;
+
+		while (order + 1 < ORDER_CNT
+				&& (page_idx & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (p, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Returns P's reserve of zeroed pages to its free lists.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *p) {
+	while (p->zeroed_cnt > 0) {
+		void *page = p->zeroed[--p->zeroed_cnt];
+		free_block (p, pg_no (page) - pg_no (p->base), 0);
+	}
+}
+
+/* Fills P's reserve of zeroed pages, a page at a time, for as long
+   as it is short and P has free pages. */
+static void
+refill_zeroed (struct pool *p) {
+	for (;;) {
+		enum intr_level old_level;
+		size_t page_idx = BITMAP_ERROR;
+		void *page;
+
+		old_level = intr_disable ();
+		if (p->zeroed_cnt < p->zeroed_max)
+			page_idx = alloc_block (p, 0);
+		intr_set_level (old_level);
+		if (page_idx == BITMAP_ERROR)
+			return;
+
+		/* Clear the page with interrupts on. */
+		page = p->base + PGSIZE * page_idx;
+		memset (page, 0, PGSIZE);
+
+		old_level = intr_disable ();
+		if (p->zeroed_cnt < p->zeroed_max)
+			p->zeroed[p->zeroed_cnt++] = page;
+		else
+			free_block (p, page_idx, 0);
+		intr_set_level (old_level);
+	}
+}
+
+/* Page-zeroing thread.  Waits for a pool's reserve to run low,
+   then refills both.  As a background thread it stays at PRI_MIN
+   under either scheduler and, like the idle thread, adds nothing
+   to the MLFQS's load average. */
+static void
+zero_thread (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&zero_sema);
+		__atomic_store_n (&zero_wanted, false, __ATOMIC_RELEASE);
+		refill_zeroed (&kernel_pool);
+		refill_zeroed (&user_pool);
+	}
+}
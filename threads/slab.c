@@ -0,0 +1,291 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator" (USENIX 1994).
+
+   A cache hands out objects of a single size.  It carves them
+   out of slabs of one page each.  The slab header sits at the
+   start of the page and the objects follow, packed at their
+   exact size rounded up to SLAB_ALIGN.  A 104-byte object thus
+   takes 104 bytes, where malloc() would use a 128-byte block.
+
+   Each slab keeps a bitmap of its free objects instead of
+   linking them through the objects themselves, so a free object
+   keeps the state its constructor gave it.
+
+   The space left over at the end of a slab is used for "cache
+   coloring".  Successive slabs start their objects at different
+   multiples of CACHE_LINE bytes, so that objects with the same
+   index in different slabs do not all compete for the same
+   cache lines.
+
+   A cache keeps its slabs on three lists: full, partially used,
+   and empty.  Allocation prefers partially used slabs to keep
+   memory dense.  At most one empty slab is kept in reserve, and
+   further empty slabs go back to the page allocator. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0b1e
+
+#define SLAB_ALIGN 8            /* Object alignment. */
+#define CACHE_LINE 64           /* Coloring granularity. */
+#define SLAB_MAP_WORDS 8        /* Words in a slab's free map. */
+#define SLAB_OBJ_MAX (SLAB_MAP_WORDS * 64) /* Objects per slab, at most. */
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of cache's lists. */
+	uint8_t *objs;              /* First object. */
+	size_t in_use;              /* Number of allocated objects. */
+	uint64_t free_map[SLAB_MAP_WORDS]; /* Bit set iff object is free. */
+};
+
+/* Object cache. */
+struct kmem_cache {
+	char name[16];              /* Name (for statistics). */
+	size_t obj_size;            /* Object size, rounded to SLAB_ALIGN. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	size_t color_max;           /* Largest color offset. */
+	size_t color_next;          /* Color offset of the next slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+	struct list_elem elem;      /* Element in all_caches. */
+
+	struct lock lock;           /* Protects the members below. */
+	struct list full;           /* Slabs with no free object. */
+	struct list partial;        /* Slabs with some free objects. */
+	struct list empty;          /* Slabs with no allocated object. */
+
+	/* Statistics. */
+	size_t slab_cnt;            /* Slabs currently owned. */
+	size_t in_use;              /* Objects currently allocated. */
+	long long alloc_cnt;        /* Total allocations. */
+	long long free_cnt;         /* Total frees. */
+};
+
+/* All caches, for kmem_print_stats(). */
+static struct list all_caches;
+static struct lock all_caches_lock;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_destroy (struct kmem_cache *, struct slab *);
+static void slab_move (struct slab *, struct list *);
+
+/* Initializes the slab allocator. */
+void
+kmem_init (void) {
+	list_init (&all_caches);
+	lock_init (&all_caches_lock);
+}
+
+/* Creates and returns a cache of SIZE-byte objects called NAME.
+   If CTOR is nonnull, it is called on every object when the
+   object's slab is created.  Returns a null pointer if memory is
+   not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor) {
+	size_t header = ROUND_UP (sizeof (struct slab), SLAB_ALIGN);
+	struct kmem_cache *c;
+	size_t leftover;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0 && size <= PGSIZE - header);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	strlcpy (c->name, name, sizeof c->name);
+	c->obj_size = ROUND_UP (size, SLAB_ALIGN);
+	c->objs_per_slab = (PGSIZE - header) / c->obj_size;
+	if (c->objs_per_slab > SLAB_OBJ_MAX)
+		c->objs_per_slab = SLAB_OBJ_MAX;
+	leftover = PGSIZE - header - c->objs_per_slab * c->obj_size;
+	c->color_max = ROUND_DOWN (leftover, CACHE_LINE);
+	c->color_next = 0;
+	c->ctor = ctor;
+	lock_init (&c->lock);
+	list_init (&c->full);
+	list_init (&c->partial);
+	list_init (&c->empty);
+	c->slab_cnt = c->in_use = 0;
+	c->alloc_cnt = c->free_cnt = 0;
+
+	lock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	lock_release (&all_caches_lock);
+	return c;
+}
+
+/* Destroys cache C, all of whose objects must have been freed. */
+void
+kmem_cache_destroy (struct kmem_cache *c) {
+	ASSERT (c != NULL);
+	ASSERT (c->in_use == 0);
+
+	lock_acquire (&all_caches_lock);
+	list_remove (&c->elem);
+	lock_release (&all_caches_lock);
+
+	while (!list_empty (&c->empty))
+		slab_destroy (c, list_entry (list_pop_front (&c->empty),
+					struct slab, elem));
+	free (c);
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+	int bit;
+	void *obj;
+
+	ASSERT (c != NULL);
+
+	lock_acquire (&c->lock);
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_front (&c->empty), struct slab, elem);
+		slab_move (s, &c->partial);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	/* Take the first free object. */
+	for (i = 0; s->free_map[i] == 0; i++)
+		ASSERT (i + 1 < SLAB_MAP_WORDS);
+	bit = __builtin_ctzll (s->free_map[i]);
+	s->free_map[i] &= ~(1ULL << bit);
+	obj = s->objs + (i * 64 + bit) * c->obj_size;
+
+	if (++s->in_use == c->objs_per_slab)
+		slab_move (s, &c->full);
+	c->in_use++;
+	c->alloc_cnt++;
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = pg_round_down (obj);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+	idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+	ASSERT (idx < c->objs_per_slab);
+
+	lock_acquire (&c->lock);
+	ASSERT ((s->free_map[idx / 64] & (1ULL << (idx % 64))) == 0);
+	s->free_map[idx / 64] |= 1ULL << (idx % 64);
+
+	if (s->in_use-- == c->objs_per_slab)
+		slab_move (s, &c->partial);
+	if (s->in_use == 0) {
+		/* Keep one empty slab in reserve. */
+		if (list_empty (&c->empty))
+			slab_move (s, &c->empty);
+		else {
+			list_remove (&s->elem);
+			slab_destroy (c, s);
+		}
+	}
+	c->in_use--;
+	c->free_cnt++;
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&all_caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		printf ("Slab %s: %zu-byte objects, %zu per slab, %zu slabs, "
+				"%zu in use, %lld allocs, %lld frees\n",
+				c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+				c->in_use, c->alloc_cnt, c->free_cnt);
+	}
+	lock_release (&all_caches_lock);
+}
+
+/* Creates a slab for cache C and constructs its objects, but
+   does not put it on any of C's lists.  C's lock must be held.
+   Returns a null pointer if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&c->lock));
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + ROUND_UP (sizeof *s, SLAB_ALIGN) + c->color_next;
+	s->in_use = 0;
+	memset (s->free_map, 0, sizeof s->free_map);
+	for (i = 0; i < c->objs_per_slab; i++)
+		s->free_map[i / 64] |= 1ULL << (i % 64);
+
+	/* Give the next slab the next color. */
+	c->color_next += CACHE_LINE;
+	if (c->color_next > c->color_max)
+		c->color_next = 0;
+
+	if (c->ctor != NULL)
+		for (i = 0; i < c->objs_per_slab; i++)
+			c->ctor (s->objs + i * c->obj_size);
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns slab S, which is on none of C's lists and has no
+   allocated objects, to the page allocator. */
+static void
+slab_destroy (struct kmem_cache *c, struct slab *s) {
+	ASSERT (s->in_use == 0);
+
+	s->magic = 0;
+	palloc_free_page (s);
+	c->slab_cnt--;
+}
+
+/* Moves slab S from its current list to LIST. */
+static void
+slab_move (struct slab *s, struct list *list) {
+	list_remove (&s->elem);
+	list_push_front (list, &s->elem);
+}
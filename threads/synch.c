@@ -27,10 +27,44 @@
    */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+static bool sema_waiter_less(const struct heap_elem *, const struct heap_elem *,
+							 void *aux);
+static int rwlock_waiter_priority(struct rwlock *);
+
+/* Lock contention profile.
+
+   If true, lock_acquire() and lock_release() keep statistics for
+   each call site of lock_acquire(), which identifies a class of
+   locks well enough in practice.  Controlled by kernel
+   command-line option "-lockprof".
+
+   The table is fixed-size and allocated statically, because
+   malloc() itself takes locks.  Call sites that do not fit are
+   lumped together in the entry whose site is null.  The table is
+   protected by turning interrupts off. */
+bool lock_profile;
+
+#define LOCK_SITE_CNT 128 /* Number of call sites tracked. */
+
+struct lock_site
+{
+	void *site;					/* Return address of lock_acquire(). */
+	long long acquire_cnt;		/* Number of acquires. */
+	long long contended_cnt;	/* Acquires that found the lock held. */
+	int64_t wait_ticks;			/* Total ticks spent acquiring. */
+	int64_t max_hold_ticks;		/* Longest hold, in ticks. */
+};
+
+static struct lock_site lock_sites[LOCK_SITE_CNT];
+
+static struct lock_site *lock_site_lookup(void *site);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,7 +80,8 @@ void sema_init(struct semaphore *sema, unsigned value)
 	ASSERT(sema != NULL);
 
 	sema->value = value;
-	list_init(&sema->waiters);
+	heap_init(&sema->waiters, sema_waiter_less, NULL);
+	sema->wait_seq = 0;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,7 +103,11 @@ sema_down(struct semaphore *sema)
 	old_level = intr_disable();
 	while (sema->value == 0)
 	{ // 0이면 현재 쓰레드는 자원을 이용할 수 없다는 뜻
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, thread_compare_priority, 0);
+		struct thread *cur = thread_current();
+
+		cur->wait_on_sema = sema;
+		cur->wait_seq = sema->wait_seq++;
+		heap_push(&sema->waiters, &cur->wait_elem);
 		thread_block();
 	}
 	sema->value--;
@@ -112,13 +151,14 @@ void sema_up(struct semaphore *sema)
 
 	old_level = intr_disable();
 
-	// Waiters 리스트를 우선순위 기준으로 정렬
-
-	if (!list_empty(&sema->waiters))
+	/* Wake the highest-priority waiter. */
+	if (!heap_empty(&sema->waiters))
 	{
-		list_sort(&sema->waiters, thread_compare_priority, NULL);
-		thread_unblock(list_entry(list_pop_front(&sema->waiters),
-								  struct thread, elem));
+		struct thread *t = heap_entry(heap_pop(&sema->waiters),
+									  struct thread, wait_elem);
+
+		t->wait_on_sema = NULL;
+		thread_unblock(t);
 	}
 	sema->value++;
 
@@ -127,6 +167,20 @@ void sema_up(struct semaphore *sema)
 	intr_set_level(old_level);
 }
 
+/* Orders semaphore waiters by priority, then by arrival, so
+   that waiters of equal priority are woken in FIFO order. */
+static bool
+sema_waiter_less(const struct heap_elem *a_, const struct heap_elem *b_,
+				 void *aux UNUSED)
+{
+	const struct thread *a = heap_entry(a_, struct thread, wait_elem);
+	const struct thread *b = heap_entry(b_, struct thread, wait_elem);
+
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+	return (int)(a->wait_seq - b->wait_seq) > 0;
+}
+
 static void sema_test_helper(void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -184,6 +238,8 @@ void lock_init(struct lock *lock)
 
 	lock->holder = NULL;
 	sema_init(&lock->semaphore, 1);
+	lock->donation.priority = PRI_MIN - 1;
+	lock->prof_site = NULL;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -196,20 +252,50 @@ void lock_init(struct lock *lock)
    we need to sleep. */
 void lock_acquire(struct lock *lock)
 {
+	enum intr_level old_level;
+	struct lock_site *site = NULL;
+	bool contended = false;
+	int64_t start = 0;
+
 	ASSERT(lock != NULL);
 	ASSERT(!intr_context());
 	ASSERT(!lock_held_by_current_thread(lock));
 
-	if (lock->holder)
+	if (lock_profile)
+	{
+		site = lock_site_lookup(__builtin_return_address(0));
+		contended = lock->holder != NULL;
+		start = timer_ticks();
+	}
+
+	/* Donate and start waiting atomically, so the holder cannot
+	   release the lock in between. */
+	old_level = intr_disable();
+
+	/* The MLFQS does not donate priority. */
+	if (lock->holder && !thread_mlfqs)
 	{
 		thread_current()->wait_on_lock = lock;
-		list_insert_ordered(&lock->holder->donations, &thread_current()->donation_elem,
-							thread_compare_donate_priority, 0);
 		donate_priority();
 	}
 
 	sema_down(&lock->semaphore);
+	thread_current()->wait_on_lock = NULL;
 	lock->holder = thread_current();
+	if (!thread_mlfqs)
+		add_with_lock(lock);
+
+	if (site != NULL)
+	{
+		lock->acquired_at = timer_ticks();
+		lock->prof_site = site;
+		site->acquire_cnt++;
+		if (contended)
+			site->contended_cnt++;
+		site->wait_ticks += lock->acquired_at - start;
+	}
+
+	intr_set_level(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -220,14 +306,21 @@ void lock_acquire(struct lock *lock)
    interrupt handler. */
 bool lock_try_acquire(struct lock *lock)
 {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT(lock != NULL);
 	ASSERT(!lock_held_by_current_thread(lock));
 
+	old_level = intr_disable();
 	success = sema_try_down(&lock->semaphore);
 	if (success)
+	{
 		lock->holder = thread_current();
+		if (!thread_mlfqs)
+			add_with_lock(lock);
+	}
+	intr_set_level(old_level);
 	return success;
 }
 
@@ -239,14 +332,109 @@ bool lock_try_acquire(struct lock *lock)
    handler. */
 void lock_release(struct lock *lock)
 {
+	enum intr_level old_level;
+
 	ASSERT(lock != NULL);
 	ASSERT(lock_held_by_current_thread(lock));
 
-	remove_with_lock(lock);
-	refresh_priority();
+	old_level = intr_disable();
+	if (lock->prof_site != NULL)
+	{
+		struct lock_site *site = lock->prof_site;
+		int64_t held = timer_ticks() - lock->acquired_at;
+
+		lock->prof_site = NULL;
+		if (held > site->max_hold_ticks)
+			site->max_hold_ticks = held;
+	}
+
+	if (!thread_mlfqs)
+	{
+		remove_with_lock(lock);
+		refresh_priority();
+	}
 
 	lock->holder = NULL;
 	sema_up(&lock->semaphore);
+	intr_set_level(old_level);
+}
+
+/* Returns the profile entry for call site SITE, creating it if
+   necessary. */
+static struct lock_site *
+lock_site_lookup(void *site)
+{
+	enum intr_level old_level;
+	struct lock_site *s;
+	size_t i, h;
+
+	old_level = intr_disable();
+	h = ((uintptr_t)site >> 2) % (LOCK_SITE_CNT - 1) + 1;
+	for (i = 0; i < LOCK_SITE_CNT - 1; i++)
+	{
+		s = &lock_sites[h];
+		if (s->site == site)
+			goto done;
+		if (s->site == NULL)
+		{
+			s->site = site;
+			goto done;
+		}
+		if (++h == LOCK_SITE_CNT)
+			h = 1;
+	}
+	s = &lock_sites[0];
+done:
+	intr_set_level(old_level);
+	return s;
+}
+
+/* Prints the lock contention profile, most contended call sites
+   first.  Call sites are return addresses into the code that
+   called lock_acquire(); utils/backtrace translates them into
+   function names. */
+void lock_print_stats(void)
+{
+	static struct lock_site *sorted[LOCK_SITE_CNT];
+	size_t cnt = 0;
+	size_t i, j;
+
+	if (!lock_profile)
+		return;
+
+	/* Insertion sort by contended acquires, then by wait time. */
+	for (i = 0; i < LOCK_SITE_CNT; i++)
+	{
+		struct lock_site *s = &lock_sites[i];
+
+		if (s->acquire_cnt == 0)
+			continue;
+		for (j = cnt++; j > 0; j--)
+		{
+			struct lock_site *t = sorted[j - 1];
+			if (t->contended_cnt > s->contended_cnt
+				|| (t->contended_cnt == s->contended_cnt
+					&& t->wait_ticks >= s->wait_ticks))
+				break;
+			sorted[j] = t;
+		}
+		sorted[j] = s;
+	}
+
+	printf("Lock profile: %zu call sites\n", cnt);
+	for (i = 0; i < cnt; i++)
+	{
+		struct lock_site *s = sorted[i];
+
+		if (s->site != NULL)
+			printf("  %p:", s->site);
+		else
+			printf("  (other sites):");
+		printf(" %lld acquires, %lld contended, %" PRId64 " wait ticks, "
+			   "%" PRId64 " max hold ticks\n",
+			   s->acquire_cnt, s->contended_cnt, s->wait_ticks,
+			   s->max_hold_ticks);
+	}
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -267,6 +455,19 @@ struct semaphore_elem
 	int semaphore_elem_priority; /* condition안에 waiter에 있는 우선순위에 접근하기 쉽게 하기 위해 변수 선언*/
 };
 
+/* Returns the priority of the thread waiting on S, or the
+   priority it had in cond_wait() if it has not started waiting
+   yet. */
+static int
+semaphore_elem_waiter_priority(struct semaphore_elem *s)
+{
+	struct heap *waiters = &s->semaphore.waiters;
+
+	if (heap_empty(waiters))
+		return s->semaphore_elem_priority;
+	return heap_entry(heap_max(waiters), struct thread, wait_elem)->priority;
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -309,7 +510,7 @@ void cond_wait(struct condition *cond, struct lock *lock)
 	sema_init(&waiter.semaphore, 0);
 	waiter.semaphore_elem_priority = thread_current()->priority;
 
-	list_insert_ordered(&cond->waiters, &waiter.elem, thread_compare_priority, 0);
+	list_push_back(&cond->waiters, &waiter.elem);
 	lock_release(lock);
 	sema_down(&waiter.semaphore);
 	lock_acquire(lock);
@@ -358,8 +559,247 @@ bool semaphore_compare_priority(const struct list_elem *l, const struct list_ele
 	struct semaphore_elem *l_sema = list_entry(l, struct semaphore_elem, elem);
 	struct semaphore_elem *s_sema = list_entry(s, struct semaphore_elem, elem);
 
-	struct list *waiter_l_sema = &(l_sema->semaphore.waiters);
-	struct list *waiter_s_sema = &(s_sema->semaphore.waiters);
+	return semaphore_elem_waiter_priority(l_sema) > semaphore_elem_waiter_priority(s_sema);
+}
+
+/* Initializes RW as an rwlock held by nobody. */
+void rwlock_init(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	rw->writer = NULL;
+	rw->donation.priority = PRI_MIN - 1;
+	rw->reader_cnt = 0;
+	list_init(&rw->readers);
+	sema_init(&rw->read_waiters, 0);
+	sema_init(&rw->write_waiters, 0);
+	rw->max_priority = PRI_MIN - 1;
+}
+
+/* Blocks the running thread on Q, a semaphore used only as a
+   priority-ordered queue, until rwlock_wake() hands it RW.
+   Donates its priority to RW's holders while it waits. */
+static void
+rwlock_wait(struct rwlock *rw, struct semaphore *q)
+{
+	struct thread *cur = thread_current();
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	cur->wait_on_rwlock = rw;
+	cur->wait_on_sema = q;
+	cur->wait_seq = q->wait_seq++;
+	heap_push(&q->waiters, &cur->wait_elem);
+	if (cur->priority > rw->max_priority)
+		rwlock_update_donation(rw);
+	thread_block();
+}
+
+/* Removes the highest-priority thread from Q and wakes it.
+   Returns the thread. */
+static struct thread *
+rwlock_wake(struct semaphore *q)
+{
+	struct thread *t = heap_entry(heap_pop(&q->waiters),
+								  struct thread, wait_elem);
+
+	t->wait_on_sema = NULL;
+	t->wait_on_rwlock = NULL;
+	thread_unblock(t);
+	return t;
+}
+
+/* Records H as the running thread's hold on RW, which already
+   counts it among its readers, and starts taking donations
+   through it. */
+static void
+rwlock_add_reader(struct rwlock *rw, struct rwlock_hold *h)
+{
+	struct thread *cur = thread_current();
+
+	h->rwlock = rw;
+	h->reader = cur;
+	list_push_back(&rw->readers, &h->elem);
+	if (!thread_mlfqs)
+		donation_add(cur, &h->donation, rw->max_priority);
+}
+
+/* Makes T the writer of RW. */
+static void
+rwlock_set_writer(struct rwlock *rw, struct thread *t)
+{
+	rw->writer = t;
+	if (!thread_mlfqs)
+		donation_add(t, &rw->donation, rw->max_priority);
+}
+
+/* Hands RW, which nobody holds, to its waiters: the
+   highest-priority writer if any writer waits, otherwise every
+   waiting reader.  Readers are counted here, so that no writer
+   gets in first, and record their holds once they run. */
+static void
+rwlock_hand_off(struct rwlock *rw)
+{
+	ASSERT(rw->writer == NULL && rw->reader_cnt == 0);
+
+	if (!heap_empty(&rw->write_waiters.waiters))
+	{
+		struct thread *t = rwlock_wake(&rw->write_waiters);
+
+		rw->max_priority = rwlock_waiter_priority(rw);
+		rwlock_set_writer(rw, t);
+	}
+	else
+	{
+		/* No writer waits, so once the readers are woken nobody
+		   does. */
+		rw->max_priority = PRI_MIN - 1;
+		while (!heap_empty(&rw->read_waiters.waiters))
+		{
+			rwlock_wake(&rw->read_waiters);
+			rw->reader_cnt++;
+		}
+	}
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it, and records the hold in H, which must stay valid
+   until rwlock_release_read().  RW must not already be held by
+   the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_read(struct rwlock *rw, struct rwlock_hold *h)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(h != NULL);
+	ASSERT(!intr_context());
+
+	old_level = intr_disable();
+	ASSERT(rw->writer != thread_current());
+	if (rw->writer != NULL || !heap_empty(&rw->write_waiters.waiters))
+		rwlock_wait(rw, &rw->read_waiters);
+	else
+		rw->reader_cnt++;
+	rwlock_add_reader(rw, h);
+	intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for reading through
+   H. */
+void rwlock_release_read(struct rwlock *rw, struct rwlock_hold *h)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(h != NULL && h->rwlock == rw);
+	ASSERT(h->reader == thread_current());
+
+	old_level = intr_disable();
+	list_remove(&h->elem);
+	h->rwlock = NULL;
+	rw->reader_cnt--;
+	if (!thread_mlfqs)
+		donation_remove(h->reader, &h->donation);
+
+	if (rw->reader_cnt == 0)
+		rwlock_hand_off(rw);
+	thread_compare_preemption();
+	intr_set_level(old_level);
+}
 
-	return list_entry(list_begin(waiter_l_sema), struct thread, elem)->priority > list_entry(list_begin(waiter_s_sema), struct thread, elem)->priority;
-}
\ No newline at end of file
+/* Acquires RW for writing, sleeping until no reader or writer
+   holds it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+
+	old_level = intr_disable();
+	ASSERT(rw->writer != thread_current());
+	if (rw->writer != NULL || rw->reader_cnt > 0)
+		rwlock_wait(rw, &rw->write_waiters);
+	else
+		rwlock_set_writer(rw, thread_current());
+	intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void rwlock_release_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(rwlock_held_for_write(rw));
+
+	old_level = intr_disable();
+	rw->writer = NULL;
+	if (!thread_mlfqs)
+		donation_remove(thread_current(), &rw->donation);
+
+	rwlock_hand_off(rw);
+	thread_compare_preemption();
+	intr_set_level(old_level);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool rwlock_held_for_write(const struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	return rw->writer == thread_current();
+}
+
+/* Returns the highest priority among the threads waiting for
+   RW, or PRI_MIN - 1 if there are none. */
+static int
+rwlock_waiter_priority(struct rwlock *rw)
+{
+	struct heap *r = &rw->read_waiters.waiters;
+	struct heap *w = &rw->write_waiters.waiters;
+	int priority = PRI_MIN - 1;
+
+	if (!heap_empty(r))
+		priority = heap_entry(heap_max(r), struct thread, wait_elem)->priority;
+	if (!heap_empty(w))
+	{
+		int p = heap_entry(heap_max(w), struct thread, wait_elem)->priority;
+		if (p > priority)
+			priority = p;
+	}
+	return priority;
+}
+
+/* Recomputes the highest priority among RW's waiters and
+   donates it to the writer or to every reader holding RW. */
+void rwlock_update_donation(struct rwlock *rw)
+{
+	struct list_elem *e;
+	int priority;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (thread_mlfqs)
+		return;
+
+	priority = rwlock_waiter_priority(rw);
+	if (priority == rw->max_priority)
+		return;
+	rw->max_priority = priority;
+
+	if (rw->writer != NULL)
+		donation_set(rw->writer, &rw->donation, priority);
+	for (e = list_begin(&rw->readers); e != list_end(&rw->readers);
+		 e = list_next(e))
+	{
+		struct rwlock_hold *h = list_entry(e, struct rwlock_hold, elem);
+		donation_set(h->reader, &h->donation, priority);
+	}
+}
@@ -10,6 +10,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,15 +25,37 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-/* sleep list */
-static struct list sleep_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority level, and bit P of
+   ready_mask is set iff ready_queues[P] is nonempty, so that
+   both enqueue and picking the highest-priority thread take
+   constant time. */
+#if PRI_MAX >= 64
+#error ready_mask requires PRI_MAX < 64
+#endif
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static unsigned ready_cnt; /* Non-background threads on the run queue. */
+/* Sleeping threads, kept in a pairing heap with the earliest
+   awake_ticks on top.  Insertion is constant time and removing the
+   earliest sleeper is O(log n) amortized, so thread_awake() only
+   does work proportional to the threads that actually expire. */
+static struct heap sleep_heap;
 // sleep_list에서 대기중인 스레드들의 wakeup_tick값 중 최소값을 저장
 static int64_t next_tick_to_awake;
 /* Idle thread. */
 static struct thread *idle_thread;
+/* All live threads, linked through all_elem, and the threads
+   whose recent_cpu has changed since their priority was last
+   recomputed, linked through mlfqs_elem.  Both lists are only
+   maintained by the MLFQS scheduler. */
+static struct list all_list;
+static struct list mlfqs_dirty_list;
+
+/* System load average, an estimate of the number of threads
+   ready to run over the past minute. */
+static fixed_t load_avg;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -66,6 +89,20 @@ static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
+static tid_t create_thread(const char *, int priority, thread_func *,
+						  void *aux, bool background);
+static void ready_queue_push(struct thread *);
+static void ready_queue_remove(struct thread *);
+static int ready_queue_max_priority(void);
+static void thread_change_priority(struct thread *, int priority);
+static bool donation_less(const struct heap_elem *, const struct heap_elem *,
+						  void *aux);
+static int mlfqs_priority(const struct thread *);
+static void mlfqs_mark_dirty(struct thread *);
+static void mlfqs_update_priorities(void);
+static void mlfqs_update_load_avg_and_recent_cpu(void);
+static bool sleep_less(const struct heap_elem *, const struct heap_elem *,
+					   void *aux);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -110,8 +147,13 @@ void thread_init(void)
 
 	/* Init the global thread context */
 	lock_init(&tid_lock);	// thread id 할당할 때 사용하는 잠금 => 두 쓰레드 충돌 방지
-	list_init(&ready_list); // 실행 준비된 쓰레드 관리
-	list_init(&sleep_list); // 어떤 값이 있을지 모르니 초기화
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init(&ready_queues[pri]);
+	ready_mask = 0;
+	heap_init(&sleep_heap, sleep_less, NULL);
+	list_init(&all_list);
+	list_init(&mlfqs_dirty_list);
+	load_avg = fp_from_int(0);
 	next_tick_to_awake = INT64_MAX;
 	list_init(&destruction_req); // 제거가 요청된 쓰레드 관리(쓰레드 종료 시 안전하게 제거하기 위해)
 
@@ -119,6 +161,8 @@ void thread_init(void)
 	initial_thread = running_thread();				  // 실행 중인 쓰레드를 initial_thread에 저장
 	init_thread(initial_thread, "main", PRI_DEFAULT); // 쓰레드 구조체 초기화, "이름", 기본 우선순위 설정
 	initial_thread->status = THREAD_RUNNING;
+	if (thread_mlfqs)
+		list_push_back(&all_list, &initial_thread->all_elem);
 	initial_thread->tid = allocate_tid(); // 고유한 쓰레드ID 할당
 }
 
@@ -154,6 +198,25 @@ void thread_tick(void)
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+	{
+		int64_t now = timer_ticks();
+
+		if (t != idle_thread && !t->background)
+		{
+			t->recent_cpu = fp_add_int(t->recent_cpu, 1);
+			mlfqs_mark_dirty(t);
+		}
+		if (now % TIMER_FREQ == 0)
+			mlfqs_update_load_avg_and_recent_cpu();
+		if (now % 4 == 0)
+		{
+			mlfqs_update_priorities();
+			if (ready_queue_max_priority() > t->priority)
+				intr_yield_on_return();
+		}
+	}
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return();
@@ -183,6 +246,27 @@ void thread_print_stats(void)
    Priority scheduling is the goal of Problem 1-3. */
 tid_t thread_create(const char *name, int priority,
 					thread_func *function, void *aux)
+{
+	return create_thread(name, priority, function, aux, false);
+}
+
+/* Creates a background kernel thread named NAME, which executes
+   FUNCTION passing AUX as the argument, like thread_create().
+   The thread keeps PRI_MIN under either scheduler, so it only
+   runs when nothing above PRI_MIN is ready, and like the idle
+   thread it is left out of the MLFQS's load average and
+   recent_cpu accounting. */
+tid_t thread_create_background(const char *name,
+							   thread_func *function, void *aux)
+{
+	return create_thread(name, PRI_MIN, function, aux, true);
+}
+
+/* Does the work of thread_create() and
+   thread_create_background(). */
+static tid_t
+create_thread(const char *name, int priority,
+			  thread_func *function, void *aux, bool background)
 {
 	struct thread *t;
 	tid_t tid;
@@ -197,6 +281,22 @@ tid_t thread_create(const char *name, int priority,
 	/* Initialize thread. */
 	init_thread(t, name, priority);
 	tid = t->tid = allocate_tid();
+	t->background = background;
+
+	/* Under the MLFQS, a thread inherits its parent's niceness and
+	   recent CPU use, and PRIORITY is ignored. */
+	if (thread_mlfqs && function != idle && !background)
+	{
+		struct thread *parent = thread_current();
+
+		t->nice = parent->nice;
+		t->recent_cpu = parent->recent_cpu;
+		t->priority = t->original_priority = mlfqs_priority(t);
+
+		enum intr_level old_level = intr_disable();
+		list_push_back(&all_list, &t->all_elem);
+		intr_set_level(old_level);
+	}
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -247,26 +347,15 @@ void thread_unblock(struct thread *t)
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
 
-	list_insert_ordered(&ready_list, &t->elem, thread_compare_priority, 0);
+	ready_queue_push(t);
 
 	t->status = THREAD_READY;
 	intr_set_level(old_level);
 }
-/* list 안에 있는 요소 우선순위 비교 */
-bool thread_compare_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-	// a와 b를 struct thread 구조체로 변환한다.
-	struct thread *thread_a = list_entry(a, struct thread, elem);
-	struct thread *thread_b = list_entry(b, struct thread, elem);
-
-	// 두 thread의 priority 값을 비교하여 a의 priority가 더 높으면 true를 반환한다.
-	return thread_a->priority > thread_b->priority;
-}
-
 /* running_thread 선점할 요소 비교하기 */
 void thread_compare_preemption(void)
 {
-	if (!list_empty(&ready_list) && thread_current()->priority < list_entry(list_front(&ready_list), struct thread, elem)->priority)
+	if (thread_current()->priority < ready_queue_max_priority())
 		thread_yield();
 }
 
@@ -315,6 +404,14 @@ void thread_exit(void)
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable();
+	if (thread_mlfqs && !thread_current()->background)
+	{
+		struct thread *curr = thread_current();
+
+		list_remove(&curr->all_elem);
+		if (curr->mlfqs_dirty)
+			list_remove(&curr->mlfqs_elem);
+	}
 	do_schedule(THREAD_DYING);
 	NOT_REACHED();
 }
@@ -330,8 +427,10 @@ void thread_sleep(int64_t ticks)
 	curr->awake_ticks = ticks;	// 깨워야 할 시점을 awake_ticks에 저장ehldjdi
 
 	if (curr != idle_thread)
-		list_push_back(&sleep_list, &curr->elem);
-	update_next_tick_to_awake(ticks);
+	{
+		heap_push(&sleep_heap, &curr->sleep_elem);
+		update_next_tick_to_awake(ticks);
+	}
 	thread_block();
 
 	intr_set_level(old_level); // 인터럽트 활성화(unblock이 될 때)
@@ -352,31 +451,44 @@ void thread_yield(void)
 	old_level = intr_disable();
 
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, thread_compare_priority, 0);
+		ready_queue_push(curr);
 	do_schedule(THREAD_READY);
 	intr_set_level(old_level);
 }
 
+/* Returns the sleeper that is due first.  SLEEP_HEAP must not be
+   empty. */
+static struct thread *
+sleep_first(void)
+{
+	return heap_entry(heap_max(&sleep_heap), struct thread, sleep_elem);
+}
+
+/* Wakes up every sleeping thread whose awake_ticks is at most
+   TICKS.  Called from the timer interrupt handler. */
 void thread_awake(int64_t ticks)
 {
-	next_tick_to_awake = INT64_MAX;				   // 최소 값을 찾기 위해 최대값으로 초기화
-	struct list_elem *e = list_begin(&sleep_list); // 첫 번째 요소를 가리키는 포인터 초기화
-	struct thread *t;
+	ASSERT(intr_get_level() == INTR_OFF);
 
-	while (e != list_end(&sleep_list))
-	{
-		t = list_entry(e, struct thread, elem);
-		if (t->awake_ticks <= ticks)
-		{
-			e = list_remove(&t->elem);
-			thread_unblock(t);
-		}
-		else
-		{
-			update_next_tick_to_awake(t->awake_ticks);
-			e = list_next(e);
-		}
-	}
+	while (!heap_empty(&sleep_heap) && sleep_first()->awake_ticks <= ticks)
+		thread_unblock(heap_entry(heap_pop(&sleep_heap), struct thread,
+								  sleep_elem));
+
+	next_tick_to_awake = !heap_empty(&sleep_heap)
+							 ? sleep_first()->awake_ticks
+							 : INT64_MAX;
+}
+
+/* Orders sleepers so that the earliest awake_ticks is the
+   greatest, that is, on top of sleep_heap. */
+static bool
+sleep_less(const struct heap_elem *a_, const struct heap_elem *b_,
+		   void *aux UNUSED)
+{
+	const struct thread *a = heap_entry(a_, struct thread, sleep_elem);
+	const struct thread *b = heap_entry(b_, struct thread, sleep_elem);
+
+	return a->awake_ticks > b->awake_ticks;
 }
 
 void update_next_tick_to_awake(int64_t ticks)
@@ -392,6 +504,10 @@ int64_t get_next_tick_to_awake(void)
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
+	/* The MLFQS computes priorities itself. */
+	if (thread_mlfqs)
+		return;
+
 	thread_current()->original_priority = new_priority;
 	refresh_priority();
 	thread_compare_preemption();
@@ -403,31 +519,140 @@ int thread_get_priority(void)
 	return thread_current()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED)
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority and yields if it no longer has the highest one. */
+void thread_set_nice(int nice)
 {
-	/* TODO: Your implementation goes here */
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	old_level = intr_disable();
+	curr->nice = nice;
+	if (thread_mlfqs)
+		thread_change_priority(curr, mlfqs_priority(curr));
+	intr_set_level(old_level);
+
+	thread_compare_preemption();
 }
 
 /* Returns the current thread's nice value. */
 int thread_get_nice(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int load = fp_to_int_round(fp_mul_int(load_avg, 100));
+	intr_set_level(old_level);
+
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int recent = fp_to_int_round(fp_mul_int(thread_current()->recent_cpu, 100));
+	intr_set_level(old_level);
+
+	return recent;
+}
+
+/* Returns the priority the MLFQS assigns to T:
+   PRI_MAX - recent_cpu / 4 - nice * 2, clamped to the valid
+   range. */
+static int
+mlfqs_priority(const struct thread *t)
+{
+	int priority = PRI_MAX - fp_to_int(fp_div_int(t->recent_cpu, 4)) - t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Notes that T's recent_cpu changed, so that its priority is
+   recomputed at the next fourth tick. */
+static void
+mlfqs_mark_dirty(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (!t->mlfqs_dirty)
+	{
+		t->mlfqs_dirty = true;
+		list_push_back(&mlfqs_dirty_list, &t->mlfqs_elem);
+	}
+}
+
+/* Recomputes the priority of every thread whose recent_cpu has
+   changed since the last time.  Only threads that actually ran
+   have, so this is cheap however many threads exist. */
+static void
+mlfqs_update_priorities(void)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	while (!list_empty(&mlfqs_dirty_list))
+	{
+		struct thread *t = list_entry(list_pop_front(&mlfqs_dirty_list),
+									  struct thread, mlfqs_elem);
+		t->mlfqs_dirty = false;
+		thread_change_priority(t, mlfqs_priority(t));
+	}
+}
+
+/* Once per second, updates the load average and decays every
+   thread's recent_cpu:
+
+	   load_avg = (59/60) * load_avg + (1/60) * ready_threads
+	   recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
+
+   A thread is only queued for a priority update if its recent_cpu
+   actually changed, which is not the case for a long-idle thread
+   whose recent_cpu has already decayed to its fixed point. */
+static void
+mlfqs_update_load_avg_and_recent_cpu(void)
+{
+	int ready_threads = ready_cnt;
+	fixed_t twice_load, decay;
+	struct list_elem *e;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (thread_current() != idle_thread && !thread_current()->background)
+		ready_threads++;
+
+	load_avg = fp_add(fp_div_int(fp_mul_int(load_avg, 59), 60),
+					  fp_div_int(fp_from_int(ready_threads), 60));
+
+	twice_load = fp_mul_int(load_avg, 2);
+	decay = fp_div(twice_load, fp_add_int(twice_load, 1));
+	for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+	{
+		struct thread *t = list_entry(e, struct thread, all_elem);
+		fixed_t recent_cpu = fp_add_int(fp_mul(decay, t->recent_cpu), t->nice);
+
+		if (recent_cpu != t->recent_cpu)
+		{
+			t->recent_cpu = recent_cpu;
+			if (!t->mlfqs_dirty)
+			{
+				t->mlfqs_dirty = true;
+				list_push_back(&mlfqs_dirty_list, &t->mlfqs_elem);
+			}
+		}
+	}
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -465,6 +690,7 @@ idle(void *idle_started_ UNUSED)
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
 		   7.11.1 "HLT Instruction". */
+		timer_idle_enter();
 		asm volatile("sti; hlt" : : : "memory");
 	}
 }
@@ -498,7 +724,8 @@ init_thread(struct thread *t, const char *name, int priority)
 
 	t->original_priority = priority;
 	t->wait_on_lock = NULL;
-	list_init(&t->donations);
+	heap_init(&t->held_locks, donation_less, NULL);
+	t->wait_on_sema = NULL;
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -509,10 +736,82 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	struct thread *t;
+
+	if (ready_mask == 0)
 		return idle_thread;
+
+	t = list_entry(list_front(&ready_queues[ready_queue_max_priority()]),
+				   struct thread, elem);
+	ready_queue_remove(t);
+	return t;
+}
+
+/* Appends T to the run queue of its current priority.
+   Interrupts must be off. */
+static void
+ready_queue_push(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	list_push_back(&ready_queues[t->priority], &t->elem);
+	ready_mask |= 1ULL << t->priority;
+	if (!t->background)
+		ready_cnt++;
+}
+
+/* Removes T from the run queue it sits on, which must be the one
+   for T's current priority.  Interrupts must be off. */
+static void
+ready_queue_remove(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	list_remove(&t->elem);
+	if (list_empty(&ready_queues[t->priority]))
+		ready_mask &= ~(1ULL << t->priority);
+	if (!t->background)
+		ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   PRI_MIN - 1 if no thread is ready. */
+static int
+ready_queue_max_priority(void)
+{
+	if (ready_mask == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll(ready_mask);
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready, or to its new place among
+   the waiters of the semaphore it is blocked on. */
+static void
+thread_change_priority(struct thread *t, int priority)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (t->status == THREAD_READY && t->priority != priority)
+	{
+		ready_queue_remove(t);
+		t->priority = priority;
+		ready_queue_push(t);
+	}
+	else if (t->status == THREAD_BLOCKED && t->wait_on_sema != NULL)
+	{
+		/* Keep the semaphore's waiters heap ordered. */
+		struct heap *waiters = &t->wait_on_sema->waiters;
+
+		heap_remove(waiters, &t->wait_elem);
+		t->priority = priority;
+		heap_push(waiters, &t->wait_elem);
+	}
 	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+		t->priority = priority;
+
+	intr_set_level(old_level);
 }
 
 /* Use iretq to launch the thread */
@@ -668,6 +967,8 @@ schedule(void)
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
+		if (curr == idle_thread)
+			idle_ticks += timer_idle_exit();
 		thread_launch(next);
 	}
 }
@@ -685,50 +986,157 @@ allocate_tid(void)
 
 	return tid;
 }
-void refresh_priority(void)
+/* Orders the donations a thread receives by priority. */
+static bool
+donation_less(const struct heap_elem *a, const struct heap_elem *b,
+			  void *aux UNUSED)
 {
-	struct thread *cur = thread_current();
-	cur->priority = cur->original_priority;
-	if (!list_empty(&cur->donations))
+	return heap_entry(a, struct donation, elem)->priority
+		   < heap_entry(b, struct donation, elem)->priority;
+}
+
+/* Returns the highest priority among the threads waiting for
+   LOCK, or PRI_MIN - 1 if there are none. */
+static int
+lock_waiter_priority(struct lock *lock)
+{
+	struct heap *waiters = &lock->semaphore.waiters;
+
+	if (heap_empty(waiters))
+		return PRI_MIN - 1;
+	return heap_entry(heap_max(waiters), struct thread, wait_elem)->priority;
+}
+
+/* Sets the priority of donation D, which HOLDER receives, to
+   PRIORITY, moving D to match in HOLDER's held_locks. */
+static void
+donation_move(struct thread *holder, struct donation *d, int priority)
+{
+	heap_remove(&holder->held_locks, &d->elem);
+	d->priority = priority;
+	heap_push(&holder->held_locks, &d->elem);
+}
+
+/* Recomputes T's effective priority as the larger of its own
+   priority and the highest priority donated to it through the
+   locks it holds.  If that changes it, and T is itself waiting
+   for a lock, the change moves on to that lock's holder, and so
+   on down the chain until a priority stays the same.  A change
+   reaching an rwlock fans out to all of its holders.
+
+   Each step costs O(log n) in the number of waiters and locks
+   involved, instead of a sort of every donor. */
+static void
+update_priority(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	for (;;)
 	{
-		list_sort(&cur->donations, thread_compare_donate_priority, 0);
-		struct thread *front = list_entry(list_front(&cur->donations),
-										  struct thread, donation_elem);
-		if (front->priority > cur->priority)
-			cur->priority = front->priority;
+		int priority = t->original_priority;
+		struct lock *lock;
+
+		if (!heap_empty(&t->held_locks))
+		{
+			struct donation *d = heap_entry(heap_max(&t->held_locks),
+											struct donation, elem);
+			if (d->priority > priority)
+				priority = d->priority;
+		}
+		if (priority == t->priority)
+			return;
+		thread_change_priority(t, priority);
+
+		if (t->wait_on_rwlock != NULL)
+		{
+			rwlock_update_donation(t->wait_on_rwlock);
+			return;
+		}
+		lock = t->wait_on_lock;
+		if (lock == NULL || lock->holder == NULL)
+			return;
+		priority = lock_waiter_priority(lock);
+		if (priority == lock->donation.priority)
+			return;
+		donation_move(lock->holder, &lock->donation, priority);
+		t = lock->holder;
 	}
 }
 
+/* Recomputes the running thread's effective priority, after it
+   released a lock or changed its own priority. */
+void refresh_priority(void)
+{
+	enum intr_level old_level = intr_disable();
+	update_priority(thread_current());
+	intr_set_level(old_level);
+}
+
+/* Donates the running thread's priority to the holder of the
+   lock it is about to wait for.  The running thread is not on
+   the lock's waiters yet, so it is accounted for here. */
 void donate_priority(void)
 {
-	int depth;
 	struct thread *cur = thread_current();
+	struct lock *lock = cur->wait_on_lock;
 
-	for (depth = 0; depth < 8; depth++)
-	{ // 최대깊이 8(GITBOOK예시로 나와있음)
-		if (!cur->wait_on_lock)
-			break;
-		struct thread *holder = cur->wait_on_lock->holder;
-		holder->priority = cur->priority;
-		cur = holder; // 우선순위가 낮았던 holder부터 실행을 해야하므로 cur를 holder로 바꿔서 지금 실행.
-	}
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(lock != NULL && lock->holder != NULL);
+
+	if (cur->priority > lock->donation.priority)
+		donation_set(lock->holder, &lock->donation, cur->priority);
 }
 
+/* Records that the running thread now holds LOCK, taking
+   donations from the threads still waiting for it. */
+void add_with_lock(struct lock *lock)
+{
+	ASSERT(lock->holder == thread_current());
+
+	donation_add(lock->holder, &lock->donation, lock_waiter_priority(lock));
+}
+
+/* Drops the donations the running thread receives through LOCK,
+   which it is about to release.  The caller recomputes its
+   priority with refresh_priority(). */
 void remove_with_lock(struct lock *lock)
 {
-	struct list_elem *e;
-	struct thread *cur = thread_current();
+	ASSERT(intr_get_level() == INTR_OFF);
 
-	for (e = list_begin(&cur->donations); e != list_end(&cur->donations);
-		 e = list_next(e))
-	{
-		struct thread *t = list_entry(e, struct thread, donation_elem);
-		if (t->wait_on_lock == lock)
-			list_remove(&t->donation_elem);
-	}
+	heap_remove(&thread_current()->held_locks, &lock->donation.elem);
+	lock->donation.priority = PRI_MIN - 1;
 }
 
-bool thread_compare_donate_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Starts donating PRIORITY to HOLDER through D, for something
+   HOLDER has just acquired, and recomputes HOLDER's priority. */
+void donation_add(struct thread *holder, struct donation *d, int priority)
 {
-	return list_entry(a, struct thread, donation_elem)->priority > list_entry(b, struct thread, donation_elem)->priority;
-}
\ No newline at end of file
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	d->priority = priority;
+	heap_push(&holder->held_locks, &d->elem);
+	update_priority(holder);
+}
+
+/* Changes the priority donated to HOLDER through D to PRIORITY
+   and recomputes HOLDER's priority. */
+void donation_set(struct thread *holder, struct donation *d, int priority)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (d->priority == priority)
+		return;
+	donation_move(holder, d, priority);
+	update_priority(holder);
+}
+
+/* Stops donating to HOLDER through D and recomputes HOLDER's
+   priority. */
+void donation_remove(struct thread *holder, struct donation *d)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	heap_remove(&holder->held_locks, &d->elem);
+	d->priority = PRI_MIN - 1;
+	update_priority(holder);
+}
@@ -1,7 +1,12 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <rhash.h>
 #include "vm/vm.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +22,277 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap slots: one page each, on consecutive sectors of the swap
+ * disk.
+ *
+ * A slot is shared by every page whose contents it holds: after
+ * fork, a page that was swapped out is not read back, the child's
+ * page just refers to the same slot, and a shared frame is written
+ * to a single slot for all of its pages.  slot_refs[] counts the
+ * pages referring to each slot; a set bit in swap_map marks a slot
+ * with references. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+static struct bitmap *swap_map;
+static unsigned *slot_refs;
+static struct lock swap_lock;   /* Protects swap_map and slot_refs. */
+
+/* Swap cache: frames that hold the unchanged contents of a swap
+ * slot, keyed by slot.  When the pages sharing a slot fault, the
+ * first one reads the slot and the others map its frame.  A cached
+ * frame is mapped read-only, so that it stays unchanged, and is
+ * clean: evicting it needs no write.  Protected by the frame lock
+ * in vm.c, which all callers of the functions below hold. */
+static struct rhash swap_cache;
+
+static rhash_hash_func swap_cache_hash;
+static rhash_less_func swap_cache_less;
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	size_t slot_cnt;
+
+	swap_disk = disk_get (1, 1);
+	lock_init (&swap_lock);
+	if (!rhash_init (&swap_cache, swap_cache_hash, swap_cache_less, NULL))
+		PANIC ("vm_anon_init: cannot allocate swap cache");
+	if (swap_disk == NULL)
+		return;
+
+	slot_cnt = disk_size (swap_disk) / SLOT_SECTORS;
+	swap_map = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	if (swap_map == NULL || slot_refs == NULL)
+		PANIC ("vm_anon_init: cannot allocate swap map");
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
+	page->anon.slot = SWAP_SLOT_NONE;
+
+	/* The frame comes zeroed from vm_get_frame(), unless a loader
+	 * is about to fill it. */
+	return true;
+}
+
+/* Returns the hash of the slot a swap cache element caches. */
+static uint64_t
+swap_cache_hash (const struct rhash_elem *e, void *aux UNUSED) {
+	const struct frame *f = rhash_entry (e, struct frame, swap_elem);
+
+	return f->swap_slot * 0x9e3779b97f4a7c15ULL;
+}
+
+/* Orders swap cache elements by slot. */
+static bool
+swap_cache_less (const struct rhash_elem *a, const struct rhash_elem *b,
+		void *aux UNUSED) {
+	return rhash_entry (a, struct frame, swap_elem)->swap_slot
+		< rhash_entry (b, struct frame, swap_elem)->swap_slot;
+}
+
+/* Returns the frame caching SLOT, or a null pointer. */
+struct frame *
+anon_swap_cache_find (size_t slot) {
+	struct frame key;
+	struct rhash_elem *e;
 
-	struct anon_page *anon_page = &page->anon;
+	key.swap_slot = slot;
+	e = rhash_find (&swap_cache, &key.swap_elem);
+	return e != NULL ? rhash_entry (e, struct frame, swap_elem) : NULL;
+}
+
+/* Records that FRAME holds the contents of SLOT.  Returns false,
+ * leaving FRAME out of the cache, if memory is too short. */
+static bool
+swap_cache_add (struct frame *frame, size_t slot) {
+	ASSERT (frame->swap_slot == SWAP_SLOT_NONE);
+
+	frame->swap_slot = slot;
+	if (!rhash_insert (&swap_cache, &frame->swap_elem, NULL)) {
+		frame->swap_slot = SWAP_SLOT_NONE;
+		return false;
+	}
+	return true;
+}
+
+/* Removes FRAME from the swap cache, if it is there, so that it may
+ * be changed. */
+void
+anon_swap_cache_remove (struct frame *frame) {
+	if (frame->swap_slot != SWAP_SLOT_NONE) {
+		rhash_delete (&swap_cache, &frame->swap_elem);
+		frame->swap_slot = SWAP_SLOT_NONE;
+	}
+}
+
+/* Drops PAGE's reference to its slot.  The slot is freed, and any
+ * frame caching it leaves the cache, once no page refers to it. */
+static void
+swap_slot_put (struct page *page) {
+	size_t slot = page->anon.slot;
+	bool last;
+
+	ASSERT (slot != SWAP_SLOT_NONE);
+
+	lock_acquire (&swap_lock);
+	ASSERT (slot_refs[slot] > 0);
+	last = --slot_refs[slot] == 0;
+	if (last)
+		bitmap_reset (swap_map, slot);
+	lock_release (&swap_lock);
+
+	if (last) {
+		struct frame *frame = anon_swap_cache_find (slot);
+		if (frame != NULL)
+			anon_swap_cache_remove (frame);
+	}
+	page->anon.slot = SWAP_SLOT_NONE;
+}
+
+/* Makes DST, a new anonymous page, share the swap slot of SRC, a
+ * page that is swapped out. */
+void
+anon_swap_share (struct page *dst, struct page *src) {
+	ASSERT (page_get_type (dst) == VM_ANON);
+	ASSERT (src->anon.slot != SWAP_SLOT_NONE);
+
+	lock_acquire (&swap_lock);
+	slot_refs[src->anon.slot]++;
+	lock_release (&swap_lock);
+	dst->anon.slot = src->anon.slot;
+}
+
+/* Writes the CNT anonymous FRAMES, which swap does not hold yet, to
+ * consecutive free slots with one disk command, or to several runs
+ * if there is no run that long, and records each frame's slot in
+ * it.  The frames are about to be freed, so they do not go in the
+ * swap cache: no other page can look for slots that were free until
+ * now.  The frames must be pinned and unmapped; no lock is needed,
+ * so that other faults go on during the write.  Returns false if
+ * swap is full. */
+bool
+anon_swap_write_frames (struct frame *frames[], size_t cnt) {
+	const void *kvas[SWAP_CLUSTER];
+	size_t slot, i;
+
+	if (cnt > SWAP_CLUSTER)
+		return anon_swap_write_frames (frames, SWAP_CLUSTER)
+			&& anon_swap_write_frames (frames + SWAP_CLUSTER, cnt - SWAP_CLUSTER);
+
+	if (swap_map == NULL)
+		return false;
+
+	lock_acquire (&swap_lock);
+	slot = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+	lock_release (&swap_lock);
+	if (slot == BITMAP_ERROR)
+		return cnt > 1
+			&& anon_swap_write_frames (frames, cnt / 2)
+			&& anon_swap_write_frames (frames + cnt / 2, cnt - cnt / 2);
+
+	for (i = 0; i < cnt; i++) {
+		ASSERT (frames[i]->swap_slot == SWAP_SLOT_NONE);
+		kvas[i] = frames[i]->kva;
+		frames[i]->swap_slot = slot + i;
+	}
+	disk_write_multiple (swap_disk, slot * SLOT_SECTORS, kvas, cnt,
+			SLOT_SECTORS);
+	return true;
+}
+
+/* Points every page in the CNT anonymous FRAMES, whose contents
+ * swap holds, either because they are in the swap cache or because
+ * anon_swap_write_frames() wrote them, at its frame's slot.  Leaves
+ * the frames out of the swap cache.  The caller must hold the frame
+ * lock. */
+void
+anon_swap_out_frames (struct frame *frames[], size_t cnt) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		struct frame *frame = frames[i];
+		struct list_elem *e;
+
+		ASSERT (frame->swap_slot != SWAP_SLOT_NONE);
+		for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+
+			ASSERT (page_get_type (page) == VM_ANON);
+			ASSERT (page->anon.slot == SWAP_SLOT_NONE);
+			page->anon.slot = frame->swap_slot;
+		}
+		lock_acquire (&swap_lock);
+		slot_refs[frame->swap_slot] += frame->ref_cnt;
+		lock_release (&swap_lock);
+		if (anon_swap_cache_find (frame->swap_slot) == frame)
+			anon_swap_cache_remove (frame);
+		else
+			frame->swap_slot = SWAP_SLOT_NONE;
+	}
+}
+
+/* Reads the CNT pages in PAGES from swap into their frames, which
+ * must be pinned and in the swap cache for the pages' slots.  The
+ * slots must be consecutive, so that they are read with one disk
+ * command.  Needs no lock. */
+void
+anon_swap_in_pages (struct page *pages[], size_t cnt) {
+	void *kvas[SWAP_CLUSTER];
+	size_t slot = pages[0]->anon.slot;
+	size_t i;
+
+	ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+	for (i = 0; i < cnt; i++) {
+		ASSERT (pages[i]->anon.slot == slot + i);
+		ASSERT (pages[i]->frame->swap_slot == slot + i);
+		kvas[i] = pages[i]->frame->kva;
+	}
+	disk_read_multiple (swap_disk, slot * SLOT_SECTORS, kvas, cnt,
+			SLOT_SECTORS);
+}
+
+/* Puts PAGE's frame in the swap cache for PAGE's slot, which it is
+ * about to be filled from.  Returns false if memory is too short. */
+bool
+anon_swap_cache_fill (struct page *page) {
+	return swap_cache_add (page->frame, page->anon.slot);
+}
+
+/* Makes PAGE, whose frame now holds the contents of its slot, give
+ * up the slot. */
+void
+anon_swap_release (struct page *page) {
+	swap_slot_put (page);
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page by read contents from the swap disk.  vm.c
+ * brings swapped-out pages in through the swap cache instead, with
+ * anon_swap_in_pages(), so this is never called. */
 static bool
-anon_swap_in (struct page *page, void *kva) {
-	struct anon_page *anon_page = &page->anon;
+anon_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	NOT_REACHED ();
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	if (page->frame->swap_slot == SWAP_SLOT_NONE
+			&& !anon_swap_write_frames (&page->frame, 1))
+		return false;
+	anon_swap_out_frames (&page->frame, 1);
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	if (page->anon.slot != SWAP_SLOT_NONE)
+		swap_slot_put (page);
 }
@@ -1,5 +1,15 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <round.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -14,45 +24,420 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* Readahead window sizes, in pages. */
+#define RA_INIT 4                       /* First window. */
+#define RA_MAX 32                       /* Largest window. */
+
+/* A batch of pages for the readahead thread to read.  Each page
+ * already has a pinned frame, which the thread fills and unpins. */
+struct readahead {
+	struct list_elem elem;              /* Element in ra_queue. */
+	size_t page_cnt;                    /* Number of pages. */
+	struct page *pages[RA_MAX];         /* The pages. */
+};
+
+static struct list ra_queue;            /* Batches waiting to be read. */
+static struct lock ra_lock;             /* Protects ra_queue. */
+static struct semaphore ra_sema;        /* Counts batches in ra_queue. */
+
+/* The readahead and writeback threads, or TID_ERROR until
+ * file_start_threads() starts them.  Protected by ra_lock. */
+static tid_t readahead_tid = TID_ERROR;
+static tid_t writeback_tid = TID_ERROR;
+
+/* Writeback.  Every vm_writeback_interval milliseconds the writeback
+ * thread writes back the file pages that have stayed dirty since its
+ * last pass, or all dirty file pages if they make up
+ * vm_dirty_background_ratio percent of the frame table.  A process
+ * that dirties file pages while vm_dirty_ratio percent are dirty
+ * writes them back itself.  An interval of 0 disables the thread,
+ * and a vm_dirty_ratio of 0 lets processes dirty pages without
+ * ever writing them back themselves. */
+unsigned vm_writeback_interval = 500;
+unsigned vm_dirty_background_ratio = 10;
+unsigned vm_dirty_ratio = 20;
+
+/* Most pages written back by one file_writeback(). */
+#define WB_MAX (PGSIZE / sizeof (struct page *))
+
+static void readahead_thread (void *aux);
+static void writeback_thread (void *aux);
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	list_init (&ra_queue);
+	lock_init (&ra_lock);
+	sema_init (&ra_sema, 0);
+}
+
+/* Starts the readahead and writeback threads, if they are not
+ * running yet.  do_mmap() calls this, so that a system that maps no
+ * files runs neither: the writeback thread wakes up every
+ * vm_writeback_interval ms, which would keep an idle tickless
+ * kernel ticking.  Returns false if a thread cannot be started. */
+static bool
+file_start_threads (void) {
+	bool success;
+
+	lock_acquire (&ra_lock);
+	if (readahead_tid == TID_ERROR)
+		readahead_tid = thread_create ("readahead", PRI_DEFAULT,
+				readahead_thread, NULL);
+	if (vm_writeback_interval > 0 && writeback_tid == TID_ERROR)
+		writeback_tid = thread_create ("writeback", PRI_DEFAULT,
+				writeback_thread, NULL);
+	success = readahead_tid != TID_ERROR
+		&& (vm_writeback_interval == 0 || writeback_tid != TID_ERROR);
+	lock_release (&ra_lock);
+	return success;
 }
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
+	/* file_map_adopt() fills in page->file. */
+	return true;
+}
+
+/* Fills in the file_page of PAGE, which has just become a file
+ * page, from LOAD, its aux while it was pending.  The page takes
+ * over LOAD's file handle. */
+static void
+file_map_adopt (struct page *page, struct page_load *load) {
 	struct file_page *file_page = &page->file;
+
+	file_page->file = load->file;
+	file_page->ofs = load->ofs;
+	file_page->read_bytes = load->read_bytes;
+	free (load);
+}
+
+/* Loads a mapped page on its first fault.  AUX is its struct
+ * page_load. */
+static bool
+file_map_load (struct page *page, void *aux) {
+	file_map_adopt (page, aux);
+	return file_backed_swap_in (page, page->frame->kva);
+}
+
+/* Adds to the running process a copy of SRC, a mapped page that has
+ * been loaded, for a fork.  The copy has its own handle to the file
+ * and is not in memory: it is read from the file on its first fault
+ * unless the caller fills it.  Returns the copy, or a null pointer
+ * if memory is short. */
+struct page *
+file_map_copy (struct page *src) {
+	struct file_page *file_page = &src->file;
+	struct page_load *load;
+	struct page *dst;
+
+	load = page_load_create (file_page->file, file_page->ofs,
+			file_page->read_bytes);
+	if (load == NULL
+			|| !vm_alloc_page_with_initializer (VM_FILE, src->va, src->writable,
+				file_map_load, load)) {
+		page_load_free (load);
+		return NULL;
+	}
+	dst = spt_find_page (&thread_current ()->spt, src->va);
+	file_backed_initializer (dst, VM_FILE, NULL);
+	file_map_adopt (dst, load);
+	return dst;
+}
+
+/* Writes the contents of PAGE's frame to its file. */
+static void
+file_page_write (struct page *page) {
+	struct file_page *file_page = &page->file;
+
+	file_write_at (file_page->file, page->frame->kva,
+			file_page->read_bytes, file_page->ofs);
+}
+
+/* Writes PAGE back to its file if any mapping of it is dirty. */
+static void
+file_write_back (struct page *page) {
+	if (page->frame != NULL && pml4_is_dirty (page->pml4, page->va)) {
+		file_page_write (page);
+		pml4_set_dirty (page->pml4, page->va, false);
+	}
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->ofs) != (off_t) file_page->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + file_page->read_bytes, 0,
+			PGSIZE - file_page->read_bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	file_write_back (page);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	file_write_back (page);
+	file_close (page->file.file);
 }
 
-/* Do the mmap */
+/* Reads the batches of pages that mmap_access() queues. */
+static void
+readahead_thread (void *aux UNUSED) {
+	for (;;) {
+		struct readahead *ra;
+		size_t i;
+
+		sema_down (&ra_sema);
+		lock_acquire (&ra_lock);
+		ra = list_entry (list_pop_front (&ra_queue), struct readahead, elem);
+		lock_release (&ra_lock);
+
+		/* The pinned frames keep the pages alive meanwhile. */
+		for (i = 0; i < ra->page_cnt; i++) {
+			struct page *page = ra->pages[i];
+			vm_prefetch_end (page, file_backed_swap_in (page, page->frame->kva));
+		}
+		free (ra);
+	}
+}
+
+/* Orders A_ and B_, pointers to file pages, by the disk sector that
+ * holds the start of their data. */
+static int
+page_sector_cmp (const void *a_, const void *b_) {
+	const struct file_page *a = &(*(struct page *const *) a_)->file;
+	const struct file_page *b = &(*(struct page *const *) b_)->file;
+	disk_sector_t a_sec = inode_sector_at (file_get_inode (a->file), a->ofs);
+	disk_sector_t b_sec = inode_sector_at (file_get_inode (b->file), b->ofs);
+
+	return a_sec < b_sec ? -1 : a_sec > b_sec;
+}
+
+/* Writes back dirty file pages, as picked by vm_writeback_begin()
+ * given RATIO, in the order of their sectors on disk, so that the
+ * disk head sweeps once across them.  Writes at most WB_MAX pages;
+ * the rest wait for the next call. */
+void
+file_writeback (unsigned ratio) {
+	struct page **pages = palloc_get_page (0);
+	size_t cnt, i;
+
+	if (pages == NULL)
+		return;
+	cnt = vm_writeback_begin (pages, WB_MAX, ratio);
+	qsort (pages, cnt, sizeof *pages, page_sector_cmp);
+	for (i = 0; i < cnt; i++) {
+		file_page_write (pages[i]);
+		vm_writeback_end (pages[i]);
+	}
+	palloc_free_page (pages);
+}
+
+/* Writes back dirty file pages in the background, so that unmapping
+ * them or evicting their frames seldom has to. */
+static void
+writeback_thread (void *aux UNUSED) {
+	for (;;) {
+		timer_msleep (vm_writeback_interval);
+		file_writeback (vm_dirty_background_ratio);
+	}
+}
+
+/* Queues the pages of mapping R from index START, up to CNT of them,
+ * that are not in memory, for the readahead thread to read.  Uses
+ * only free frames. */
+static void
+readahead (struct mmap_region *r, size_t start, size_t cnt) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct readahead *ra;
+	size_t i;
+
+	ASSERT (cnt <= RA_MAX);
+
+	ra = malloc (sizeof *ra);
+	if (ra == NULL)
+		return;
+	ra->page_cnt = 0;
+	for (i = start; i < start + cnt && i < r->page_cnt; i++) {
+		struct page *page = spt_find_page (spt,
+				(uint8_t *) r->base + i * PGSIZE);
+
+		if (page == NULL || page->mmap != r || page->frame != NULL)
+			continue;
+		if (page->operations->type == VM_UNINIT) {
+			struct page_load *load = page->uninit.aux;
+
+			file_backed_initializer (page, VM_FILE, NULL);
+			file_map_adopt (page, load);
+		}
+		if (!vm_prefetch_begin (page))
+			break;
+		ra->pages[ra->page_cnt++] = page;
+	}
+
+	if (ra->page_cnt == 0) {
+		free (ra);
+		return;
+	}
+	lock_acquire (&ra_lock);
+	list_push_back (&ra_queue, &ra->elem);
+	lock_release (&ra_lock);
+	sema_up (&ra_sema);
+}
+
+/* Tracks how the process reads PAGE's mapping, given that PAGE has
+ * just been mapped after a fault or by fault-around.  RESIDENT is
+ * true if PAGE was already in memory, because it was read ahead.
+ *
+ * As in Linux, a fault on the page after the last one faulted on
+ * starts readahead of the next RA_INIT pages.  When the reader
+ * reaches the first page of a readahead window, the next window,
+ * twice as large up to RA_MAX, is read while it works through this
+ * one.  A fault that is not sequential stops readahead. */
+void
+mmap_access (struct page *page, bool resident) {
+	struct mmap_region *r = page->mmap;
+	size_t idx = pg_no (page->va) - pg_no (r->base);
+	bool sequential = idx == r->next;
+
+	r->next = idx + 1;
+	if (resident) {
+		if (r->ra_size == 0 || idx != r->ra_start)
+			return;
+		r->ra_start += r->ra_size;
+		r->ra_size = r->ra_size * 2 < RA_MAX ? r->ra_size * 2 : RA_MAX;
+	} else if (sequential) {
+		r->ra_start = idx + 1;
+		if (r->ra_size == 0)
+			r->ra_size = RA_INIT;
+	} else {
+		r->ra_size = 0;
+		return;
+	}
+	readahead (r, r->ra_start, r->ra_size);
+}
+
+/* Returns a copy of mapping SRC for a forked process, with no
+ * pages yet, or a null pointer if memory is short. */
+struct mmap_region *
+mmap_region_copy (const struct mmap_region *src) {
+	struct mmap_region *r = malloc (sizeof *r);
+
+	if (r != NULL) {
+		*r = *src;
+		r->ref_cnt = 0;
+		r->next = r->ra_start = r->ra_size = 0;
+	}
+	return r;
+}
+
+/* Makes PAGE one of the pages of mapping R. */
+void
+mmap_region_add_page (struct mmap_region *r, struct page *page) {
+	page->mmap = r;
+	r->ref_cnt++;
+}
+
+/* Drops a page's reference to mapping R, freeing R with the last. */
+void
+mmap_region_put (struct mmap_region *r) {
+	ASSERT (r->ref_cnt > 0);
+
+	if (--r->ref_cnt == 0)
+		free (r);
+}
+
+/* Do the mmap.  Maps LENGTH bytes of FILE from OFFSET at ADDR, page
+ * by page, each loaded on its first fault or read ahead.  Returns
+ * ADDR, or a null pointer if the range is invalid or overlaps
+ * existing pages. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	off_t file_len = file_length (file);
+	struct mmap_region *r;
+	size_t page_cnt, i;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || offset % PGSIZE != 0
+			|| length == 0 || offset >= file_len)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if ((uint64_t) addr + page_cnt * PGSIZE < (uint64_t) addr
+			|| !is_user_vaddr ((uint8_t *) addr + page_cnt * PGSIZE - 1))
+		return NULL;
+	for (i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, (uint8_t *) addr + i * PGSIZE) != NULL)
+			return NULL;
+	if (!file_start_threads ())
+		return NULL;
+
+	r = malloc (sizeof *r);
+	if (r == NULL)
+		return NULL;
+	*r = (struct mmap_region) {
+		.base = addr,
+		.page_cnt = page_cnt,
+	};
+
+	for (i = 0; i < page_cnt; i++) {
+		void *upage = (uint8_t *) addr + i * PGSIZE;
+		off_t ofs = offset + i * PGSIZE;
+		size_t read_bytes = ofs < file_len ? file_len - ofs : 0;
+		struct page_load *load;
+
+		if (read_bytes > PGSIZE)
+			read_bytes = PGSIZE;
+		load = page_load_create (file, ofs, read_bytes);
+		if (load == NULL
+				|| !vm_alloc_page_with_initializer (VM_FILE, upage, writable,
+					file_map_load, load)) {
+			page_load_free (load);
+			if (i > 0)
+				do_munmap (addr);
+			else
+				free (r);
+			return NULL;
+		}
+		mmap_region_add_page (r, spt_find_page (spt, upage));
+	}
+	return addr;
 }
 
-/* Do the munmap */
+/* Removes PAGE if it belongs to mapping R_. */
+static bool
+unmap_page (struct page *page, void *r_) {
+	if (page->mmap == r_)
+		spt_remove_page (&thread_current ()->spt, page);
+	return true;
+}
+
+/* Do the munmap.  Writes back the dirty pages of the mapping that
+ * starts at ADDR and removes them. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page = spt_find_page (spt, addr);
+	struct mmap_region *r;
+
+	if (page == NULL || page->mmap == NULL || page->mmap->base != addr)
+		return;
+	r = page->mmap;
+	spt_for_each (spt, addr, (uint8_t *) addr + r->page_cnt * PGSIZE,
+			unmap_page, r);
 }
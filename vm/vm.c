@@ -1,9 +1,65 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Caches for struct page and struct frame. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+
+/* Frame table: every frame holding user pages, in the order the
+ * clock hand sweeps them.  The frame lock protects the table, the
+ * hand and the sharing state of every frame.  It is not held for
+ * disk I/O: a frame being read, written back or evicted is pinned
+ * instead, and others wait on fill_cond until it is unpinned. */
+static struct list frame_table;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+
+/* Signaled when pinned frames are unpinned: those filled for the
+ * swap cache or by readahead, those written back, and those
+ * evicted. */
+static struct condition fill_cond;
+
+/* Radix-tree shape.  See struct supplemental_page_table. */
+#define SPT_LEVELS 4                    /* Levels of nodes. */
+#define SPT_FANOUT 512                  /* Entries per node. */
+#define SPT_CNT_MASK PGMASK             /* Child count in an entry. */
+
+/* Most pages read from swap on one fault. */
+#define SWAP_READAHEAD 8
+
+/* Frames the clock looks past its first dirty candidate for a clean
+ * one before it settles for the dirty frame. */
+#define VICTIM_LOOKAHEAD 8
+
+/* Size of the window of pages mapped on a fault, which includes the
+ * faulting page.  Set by the -fault-around option; 1 maps only the
+ * faulting page. */
+size_t vm_fault_around = 16;
+
+/* Print each process's page faults when it exits?  Set by the
+ * -fault-stats option. */
+bool vm_fault_stats;
+
+/* Pages mapped around faults.  exception.c counts the faults.
+ * Updated atomically: faults run in parallel. */
+static long long fault_around_cnt;
+
+/* File pages dirty at the last writeback scan, plus those mapped
+ * writable since.  Protected by the frame lock. */
+static size_t dirty_file_cnt;
+
+/* Lowest address the stack may grow down to. */
+#define STACK_LIMIT (USER_STACK - (1 << 20))
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +71,11 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	list_init (&frame_table);
+	lock_init (&frame_lock);
+	cond_init (&fill_cond);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,156 +95,1252 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_fill_frame (struct page *page, struct frame *frame);
 static struct frame *vm_evict_frame (void);
+static void vm_release_frame (struct frame *);
+static unsigned frame_remove_page (struct page *);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
- * `vm_alloc_page`. */
+ * `vm_alloc_page`.  AUX is null or a struct page_load, which the page
+ * then owns. */
 bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool (*initializer) (struct page *, enum vm_type, void *);
+	struct page *page;
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
-
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	ASSERT (pg_ofs (upage) == 0);
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+	if (spt_find_page (spt, upage) != NULL)
+		return false;
 
-		/* TODO: Insert the page into the spt. */
+	switch (VM_TYPE (type)) {
+		case VM_ANON:
+			initializer = anon_initializer;
+			break;
+		case VM_FILE:
+			initializer = file_backed_initializer;
+			break;
+		default:
+			return false;
 	}
-err:
-	return false;
+
+	page = kmem_cache_alloc (page_cache);
+	if (page == NULL)
+		return false;
+	uninit_new (page, upage, init, type, aux, initializer);
+	page->writable = writable;
+	page->pml4 = thread_current ()->pml4;
+
+	if (!spt_insert_page (spt, page)) {
+		kmem_cache_free (page_cache, page);
+		return false;
+	}
+	return true;
+}
+
+/* Returns the index into a level-LEVEL node of the entry that
+ * covers VA. */
+static inline size_t
+spt_index (const void *va, int level) {
+	return ((uint64_t) va >> (PML4SHIFT - 9 * level)) & (SPT_FANOUT - 1);
+}
+
+/* Returns the node that interior entry E points to. */
+static inline uint64_t *
+spt_child (uint64_t e) {
+	return (uint64_t *) (e & ~SPT_CNT_MASK);
 }
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	uint64_t *node = spt->root;
+	int level;
 
-	return page;
+	for (level = 0; node != NULL && level < SPT_LEVELS - 1; level++) {
+		uint64_t e = node[spt_index (va, level)];
+		node = e != 0 ? spt_child (e) : NULL;
+	}
+	return node != NULL ? (struct page *) node[spt_index (va, level)] : NULL;
 }
 
-/* Insert PAGE into spt with validation. */
+/* Insert PAGE into spt with validation.  Fails if a page already
+ * occupies PAGE's address or a node cannot be allocated. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	uint64_t *path[SPT_LEVELS - 1];
+	bool created[SPT_LEVELS - 1];
+	uint64_t *node, *slot;
+	int level;
+
+	ASSERT (pg_ofs (page->va) == 0);
+
+	if (spt->root == NULL && (spt->root = palloc_get_page (PAL_ZERO)) == NULL)
+		return false;
+
+	/* Walk down, creating missing nodes. */
+	node = spt->root;
+	for (level = 0; level < SPT_LEVELS - 1; level++) {
+		path[level] = &node[spt_index (page->va, level)];
+		created[level] = *path[level] == 0;
+		if (created[level]) {
+			uint64_t *child = palloc_get_page (PAL_ZERO);
+			if (child == NULL)
+				goto fail;
+			*path[level] = (uint64_t) child;
+		}
+		node = spt_child (*path[level]);
+	}
+
+	slot = &node[spt_index (page->va, level)];
+	if (*slot != 0) {
+		level = SPT_LEVELS - 1;
+		goto fail;
+	}
+	*slot = (uint64_t) page;
+	spt->page_cnt++;
+
+	/* Each node that gained an entry bumps the count its parent
+	 * keeps for it; a new node is itself a new entry one level up. */
+	for (level = SPT_LEVELS - 2; level >= 0; level--) {
+		*path[level] += 1;
+		if (!created[level])
+			break;
+	}
+	return true;
 
-	return succ;
+fail:
+	/* Free the nodes this call created, which are all empty. */
+	while (level-- > 0)
+		if (created[level]) {
+			palloc_free_page (spt_child (*path[level]));
+			*path[level] = 0;
+		}
+	return false;
+}
+
+/* Removes PAGE from SPT without freeing it.  Nodes left empty are
+ * freed, unless a walk is in progress, in which case the walk frees
+ * them once it has left them. */
+static void
+spt_unlink (struct supplemental_page_table *spt, struct page *page) {
+	uint64_t *path[SPT_LEVELS - 1];
+	uint64_t *node = spt->root;
+	int level;
+
+	for (level = 0; level < SPT_LEVELS - 1; level++) {
+		ASSERT (node != NULL);
+		path[level] = &node[spt_index (page->va, level)];
+		node = spt_child (*path[level]);
+	}
+	ASSERT (node[spt_index (page->va, level)] == (uint64_t) page);
+	node[spt_index (page->va, level)] = 0;
+	spt->page_cnt--;
+
+	for (level = SPT_LEVELS - 2; level >= 0; level--) {
+		*path[level] -= 1;
+		if ((*path[level] & SPT_CNT_MASK) != 0 || spt->walk_depth > 0)
+			break;
+		palloc_free_page (spt_child (*path[level]));
+		*path[level] = 0;
+	}
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	spt_unlink (spt, page);
 	vm_dealloc_page (page);
+}
+
+/* Calls ACTION for the pages of the level-LEVEL NODE, which covers
+ * addresses from BASE, that lie in [START, END), in address order.
+ * ENTRY is the parent's entry for NODE, or null for the root.
+ * Frees child nodes that ACTION left empty. */
+static bool
+spt_walk (struct supplemental_page_table *spt, uint64_t *node, uint64_t *entry,
+		int level, uint64_t base, uint64_t start, uint64_t end,
+		spt_action_func *action, void *aux) {
+	int shift = PML4SHIFT - 9 * level;
+	size_t i = start > base ? (start - base) >> shift : 0;
+	bool ok = true;
+
+	for (; ok && i < SPT_FANOUT; i++) {
+		uint64_t va = base + ((uint64_t) i << shift);
+
+		if (va >= end)
+			break;
+		if (node[i] == 0)
+			continue;
+		if (level == SPT_LEVELS - 1) {
+			ok = action ((struct page *) node[i], aux);
+			continue;
+		}
+
+		ok = spt_walk (spt, spt_child (node[i]), &node[i], level + 1, va,
+				start, end, action, aux);
+		if ((node[i] & SPT_CNT_MASK) == 0) {
+			palloc_free_page (spt_child (node[i]));
+			node[i] = 0;
+			if (entry != NULL)
+				*entry -= 1;
+		}
+	}
+	return ok;
+}
+
+/* Calls ACTION for each page of SPT whose address lies in [START,
+ * END), in increasing address order, until ACTION returns false.
+ * Returns false if ACTION did.  ACTION may remove the page it is
+ * given from SPT, but must not otherwise add or remove pages. */
+bool
+spt_for_each (struct supplemental_page_table *spt, void *start, void *end,
+		spt_action_func *action, void *aux) {
+	bool ok;
+
+	if (spt->root == NULL)
+		return true;
+
+	spt->walk_depth++;
+	ok = spt_walk (spt, spt->root, NULL, 0, 0, (uint64_t) start,
+			(uint64_t) end, action, aux);
+	spt->walk_depth--;
+	return ok;
+}
+
+/* Returns a new page_load for READ_BYTES bytes of FILE at OFS,
+ * with its own handle to FILE, or a null pointer on failure. */
+struct page_load *
+page_load_create (struct file *file, off_t ofs, size_t read_bytes) {
+	struct page_load *load = malloc (sizeof *load);
+
+	if (load == NULL)
+		return NULL;
+	load->file = file_reopen (file);
+	if (load->file == NULL) {
+		free (load);
+		return NULL;
+	}
+	load->ofs = ofs;
+	load->read_bytes = read_bytes;
+	return load;
+}
+
+/* Returns a copy of LOAD, or a null pointer on failure. */
+struct page_load *
+page_load_copy (const struct page_load *load) {
+	return page_load_create (load->file, load->ofs, load->read_bytes);
+}
+
+/* Fills the page at KVA as LOAD describes.  Returns true if the
+ * whole read succeeded. */
+bool
+page_load_read (const struct page_load *load, void *kva) {
+	if (file_read_at (load->file, kva, load->read_bytes, load->ofs)
+			!= (off_t) load->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + load->read_bytes, 0, PGSIZE - load->read_bytes);
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Frees LOAD and closes its file. */
+void
+page_load_free (struct page_load *load) {
+	if (load != NULL) {
+		file_close (load->file);
+		free (load);
+	}
+}
+
+/* Returns the frame after E in the frame table, wrapping around
+ * at the end. */
+static struct list_elem *
+clock_next (struct list_elem *e) {
+	e = list_next (e);
+	return e != list_end (&frame_table) ? e : list_begin (&frame_table);
+}
+
+/* Returns true if claiming PAGE, which is not in memory, needs a
+ * zeroed frame.  Only a page with nothing to load, such as a stack
+ * page, does: a loader, a file read or a swap read fills the whole
+ * frame, zeroing any tail itself. */
+static bool
+page_needs_zero (struct page *page) {
+	return page->operations->type == VM_UNINIT && page->uninit.init == NULL;
+}
+
+/* Returns true if FRAME holds anonymous pages, which are saved to
+ * swap.  The caller must hold the frame lock. */
+static bool
+frame_is_anon (struct frame *frame) {
+	return frame->page != NULL && frame->page->operations->type == VM_ANON;
+}
+
+/* Returns true if FRAME holds a page of a mapped file that is not
+ * being read or written.  The caller must hold the frame lock. */
+static bool
+frame_is_file (struct frame *frame) {
+	return !frame->pinned && frame->page != NULL
+		&& frame->page->operations->type == VM_FILE;
+}
+
+/* Returns true if FRAME may be mapped writable: it is neither
+ * shared nor cached as the contents of a swap slot.  The caller
+ * must hold the frame lock. */
+static bool
+frame_is_private (struct frame *frame) {
+	return frame->ref_cnt == 1 && frame->swap_slot == SWAP_SLOT_NONE;
+}
+
+/* Returns true if any mapping of FRAME was accessed, and clears
+ * the accessed bits if CLEAR.  Sets *DIRTY if any mapping is
+ * dirty. */
+static bool
+frame_test_accessed (struct frame *frame, bool clear, bool *dirty) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	*dirty = false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (pml4_is_accessed (page->pml4, page->va)) {
+			if (clear)
+				pml4_set_accessed (page->pml4, page->va, false);
+			accessed = true;
+		}
+		if (pml4_is_dirty (page->pml4, page->va))
+			*dirty = true;
+	}
+
+	/* An anonymous frame is clean only if swap still holds it. */
+	if (frame_is_anon (frame))
+		*dirty = frame->swap_slot == SWAP_SLOT_NONE;
+	return accessed;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * Runs the clock: the hand sweeps the frame table, giving each
+ * frame that was accessed through any of its mappings a second
+ * chance.  The first frame that was neither accessed nor is dirty
+ * is taken.  Dirty frames cost a write, so the first unaccessed
+ * dirty frame only becomes a candidate, and the clock looks up to
+ * VICTIM_LOOKAHEAD frames further for a clean one.  The lookahead
+ * leaves accessed bits alone and the hand stays just past the
+ * candidate, so frames it passes keep their second chance.
+ * Returns a null pointer if every frame is pinned.  The caller must
+ * hold the frame lock. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	size_t i, frame_cnt = list_size (&frame_table);
+
+	if (frame_cnt == 0)
+		return NULL;
+	if (clock_hand == NULL)
+		clock_hand = list_begin (&frame_table);
+
+	/* The first sweep clears every accessed bit, so by the end of
+	 * the second each unpinned frame has been a candidate. */
+	for (i = 0; i < 2 * frame_cnt; i++) {
+		struct frame *frame = list_entry (clock_hand, struct frame, table_elem);
+		struct list_elem *e;
+		bool dirty;
+		size_t j;
+
+		clock_hand = clock_next (clock_hand);
+		if (frame->pinned || frame->ref_cnt == 0)
+			continue;
+		if (frame_test_accessed (frame, true, &dirty))
+			continue;
+		if (!dirty)
+			return frame;
 
-	return victim;
+		for (e = clock_hand, j = 0; j < VICTIM_LOOKAHEAD && j < frame_cnt;
+				e = clock_next (e), j++) {
+			struct frame *next = list_entry (e, struct frame, table_elem);
+
+			if (next != frame && !next->pinned && next->ref_cnt > 0
+					&& !frame_test_accessed (next, false, &dirty) && !dirty)
+				return next;
+		}
+		return frame;
+	}
+	return NULL;
+}
+
+/* Continues the clock from the hand to gather more anonymous frames
+ * to evict along with one just chosen, so that they are all written
+ * to swap together.  Gathers up to MAX_CNT frames into FRAMES, pins
+ * them, and returns how many it gathered.  Looks at no more than
+ * SWAP_CLUSTER frames.  The caller must hold the frame lock. */
+static size_t
+vm_gather_cluster (struct frame *frames[], size_t max_cnt) {
+	size_t i, frame_cnt = 0;
+
+	for (i = 0; i < SWAP_CLUSTER && frame_cnt < max_cnt; i++) {
+		struct frame *frame = list_entry (clock_hand, struct frame, table_elem);
+		bool dirty;
+
+		if (frame->pinned || frame->ref_cnt == 0)
+			break;
+		clock_hand = clock_next (clock_hand);
+		if (!frame_is_anon (frame)
+				|| frame_test_accessed (frame, true, &dirty))
+			continue;
+
+		frame->pinned = true;
+		frames[frame_cnt++] = frame;
+	}
+	return frame_cnt;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.  The frame is returned pinned, still in the
+ * frame table, with no pages.
+ *
+ * When the victim holds anonymous pages, other anonymous frames the
+ * clock would evict next are evicted with it, and those not already
+ * in swap are written to consecutive swap slots with one disk
+ * command.  The extra frames are freed, so the next few allocations
+ * do not need to evict.
+ *
+ * The frames are pinned and unmapped under the frame lock, and the
+ * lock is dropped for the write, so that other faults go on
+ * meanwhile.  A fault on one of the pages waits on fill_cond until
+ * the frames are detached. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *cluster[SWAP_CLUSTER], *dirty[SWAP_CLUSTER];
+	size_t frame_cnt, dirty_cnt = 0, i;
+	struct list_elem *e;
+	bool anon;
 
-	return NULL;
+	lock_acquire (&frame_lock);
+	cluster[0] = vm_get_victim ();
+	if (cluster[0] == NULL) {
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	cluster[0]->pinned = true;
+	frame_cnt = 1;
+	anon = frame_is_anon (cluster[0]);
+	if (anon)
+		frame_cnt += vm_gather_cluster (cluster + 1, SWAP_CLUSTER - 1);
+
+	/* Unmap every page first, so none is written while it is
+	 * being saved.  Clearing the mapping keeps its dirty bit. */
+	for (i = 0; i < frame_cnt; i++)
+		for (e = list_begin (&cluster[i]->pages);
+				e != list_end (&cluster[i]->pages); e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+			pml4_clear_page (page->pml4, page->va);
+		}
+
+	/* A frame in the swap cache is saved already.  Its pages take
+	 * its slot now, before the swap cache can drop it. */
+	if (anon)
+		for (i = 0; i < frame_cnt; i++) {
+			if (cluster[i]->swap_slot == SWAP_SLOT_NONE)
+				dirty[dirty_cnt++] = cluster[i];
+			else
+				anon_swap_out_frames (&cluster[i], 1);
+		}
+	lock_release (&frame_lock);
+
+	/* Save the rest. */
+	if (anon) {
+		if (dirty_cnt > 0 && !anon_swap_write_frames (dirty, dirty_cnt))
+			PANIC ("vm_evict_frame: out of swap");
+	} else
+		for (e = list_begin (&cluster[0]->pages);
+				e != list_end (&cluster[0]->pages); e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+
+			if (!swap_out (page))
+				PANIC ("vm_evict_frame: cannot swap out page at %p", page->va);
+		}
+
+	lock_acquire (&frame_lock);
+	anon_swap_out_frames (dirty, dirty_cnt);
+	for (i = 0; i < frame_cnt; i++) {
+		while (!list_empty (&cluster[i]->pages))
+			frame_remove_page (list_entry (list_front (&cluster[i]->pages),
+						struct page, frame_elem));
+		if (i > 0) {
+			cluster[i]->pinned = false;
+			vm_release_frame (cluster[i]);
+		}
+	}
+	cluster[0]->dirty_seen = false;
+	cond_broadcast (&fill_cond, &frame_lock);
+	lock_release (&frame_lock);
+	return cluster[0];
+}
+
+/* Returns a new frame for the user page at KVA, pinned, and adds it
+ * to the frame table. */
+static struct frame *
+vm_new_frame (void *kva) {
+	struct frame *frame = kmem_cache_alloc (frame_cache);
+
+	if (frame == NULL)
+		PANIC ("vm_new_frame: out of memory");
+	frame->kva = kva;
+	frame->page = NULL;
+	list_init (&frame->pages);
+	frame->ref_cnt = 0;
+	frame->pinned = true;
+	frame->swap_slot = SWAP_SLOT_NONE;
+	frame->dirty_seen = false;
+
+	lock_acquire (&frame_lock);
+	list_push_back (&frame_table, &frame->table_elem);
+	lock_release (&frame_lock);
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.  The frame is returned pinned, so that it is not evicted
+ * before it is mapped.  It is zeroed only if ZERO is true: callers
+ * that fill the whole frame do not pay for it. */
 static struct frame *
-vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+vm_get_frame (bool zero) {
+	struct frame *frame;
+	void *kva = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+
+	if (kva == NULL) {
+		frame = vm_evict_frame ();
+		if (frame == NULL)
+			PANIC ("vm_get_frame: out of frames");
+		if (zero)
+			memset (frame->kva, 0, PGSIZE);
+	} else
+		frame = vm_new_frame (kva);
 
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Removes FRAME, which no page uses, from the frame table and
+ * frees it.  The caller must hold the frame lock. */
+static void
+vm_release_frame (struct frame *frame) {
+	ASSERT (frame->ref_cnt == 0);
+
+	anon_swap_cache_remove (frame);
+	if (clock_hand == &frame->table_elem)
+		clock_hand = list_size (&frame_table) > 1
+			? clock_next (clock_hand) : NULL;
+	list_remove (&frame->table_elem);
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_cache, frame);
+}
+
+/* Makes PAGE one of the pages sharing FRAME.  The caller must hold
+ * the frame lock, unless FRAME is pinned. */
+static void
+frame_add_page (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->ref_cnt++;
+	frame->page = page;
+	page->frame = frame;
+}
+
+/* Removes PAGE from the pages sharing its frame and returns the
+ * number still sharing it.  The caller must hold the frame lock. */
+static unsigned
+frame_remove_page (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove (&page->frame_elem);
+	frame->ref_cnt--;
+	if (frame->page == page)
+		frame->page = frame->ref_cnt > 0
+			? list_entry (list_front (&frame->pages), struct page, frame_elem)
+			: NULL;
+	page->frame = NULL;
+	return frame->ref_cnt;
+}
+
+/* Unmaps PAGE and drops its reference to its frame, freeing the
+ * frame if that was the last one.  The caller must hold the frame
+ * lock. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_free_frame (struct page *page) {
+	struct frame *frame = page->frame;
+
+	pml4_clear_page (page->pml4, page->va);
+	if (frame_remove_page (page) == 0)
+		vm_release_frame (frame);
+}
+
+/* Maps PAGE's frame at PAGE's address in the running process,
+ * writable if WRITABLE, replacing any earlier mapping.  The caller
+ * must hold the frame lock, or PAGE's frame could be evicted. */
+static bool
+vm_map_page (struct page *page, bool writable) {
+	pml4_clear_page (page->pml4, page->va);
+	return pml4_set_page (page->pml4, page->va, page->frame->kva, writable);
+}
+
+/* Growing the stack. */
+static bool
+vm_stack_growth (void *addr) {
+	void *upage = pg_round_down (addr);
+
+	return vm_alloc_page (VM_ANON | VM_MARKER_0, upage, true)
+		&& vm_claim_page (upage);
+}
+
+/* Handle the fault on write_protected page: the first write to a
+ * page shared copy-on-write.  The writer gets a private copy of the
+ * frame, or takes the frame over if the other sharers are gone. */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *new = NULL;
+	bool success = true;
+
+	if (!page->writable)
+		return false;
+
+	lock_acquire (&frame_lock);
+	for (;;) {
+		/* The frame may be being evicted. */
+		while (page->frame != NULL && page->frame->pinned)
+			cond_wait (&fill_cond, &frame_lock);
+		if (page->frame == NULL || page->frame->ref_cnt == 1 || new != NULL)
+			break;
+
+		/* Allocating may evict, so not under the lock. */
+		lock_release (&frame_lock);
+		new = vm_get_frame (false);
+		lock_acquire (&frame_lock);
+	}
+
+	/* If the page was evicted meanwhile, the write faults again
+	 * and loads it.  A frame this page alone uses may still be in
+	 * the swap cache; it leaves the cache and stops being clean. */
+	if (page->frame != NULL) {
+		if (page->frame->ref_cnt > 1) {
+			memcpy (new->kva, page->frame->kva, PGSIZE);
+			frame_remove_page (page);
+			frame_add_page (new, page);
+			new->pinned = false;
+			new = NULL;
+		} else
+			anon_swap_cache_remove (page->frame);
+		success = vm_map_page (page, true);
+	}
+
+	/* Sharers went away while we allocated. */
+	if (new != NULL) {
+		new->pinned = false;
+		vm_release_frame (new);
+	}
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* If a frame in the swap cache holds the slot of PAGE, a swapped-out
+ * anonymous page, makes PAGE share that frame, sets *SUCCESS to
+ * whether it could be mapped, and returns true.  Waits while the
+ * frame is still being read.  The caller must hold the frame lock. */
+static bool
+swap_cache_join (struct page *page, bool *success) {
+	struct frame *frame;
+
+	while ((frame = anon_swap_cache_find (page->anon.slot)) != NULL
+			&& frame->pinned)
+		cond_wait (&fill_cond, &frame_lock);
+	if (frame == NULL)
+		return false;
+
+	frame_add_page (frame, page);
+	anon_swap_release (page);
+	*success = vm_map_page (page, page->writable && frame_is_private (frame));
+	return true;
+}
+
+/* Claims PAGE, an anonymous page in swap.
+ *
+ * If another page sharing PAGE's slot, such as its copy in a forked
+ * process, has already brought the slot in, PAGE maps that frame.
+ * Otherwise the slot is read, and the frame goes in the swap cache
+ * for the other pages sharing the slot.
+ *
+ * Reads ahead the pages that follow PAGE in memory if they also
+ * follow it in swap, as pages evicted together do, with the same
+ * disk command.  Only free frames are used for readahead; it never
+ * evicts. */
+static bool
+vm_claim_swapped (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *run[SWAP_READAHEAD];
+	struct frame *frames[SWAP_READAHEAD];
+	bool joined, success = false;
+	size_t cnt, i;
+
+	lock_acquire (&frame_lock);
+	joined = swap_cache_join (page, &success);
+	lock_release (&frame_lock);
+	if (joined)
+		return success;
+
+	/* Only this process changes its swapped-out pages, so the run
+	 * stays valid while the frames are allocated. */
+	run[0] = page;
+	frames[0] = vm_get_frame (false);
+	for (cnt = 1; cnt < SWAP_READAHEAD; cnt++) {
+		struct page *next = spt_find_page (spt,
+				(uint8_t *) page->va + cnt * PGSIZE);
+		void *kva;
+
+		if (next == NULL || next->operations->type != VM_ANON
+				|| next->frame != NULL
+				|| next->anon.slot != page->anon.slot + cnt)
+			break;
+		kva = palloc_get_page (PAL_USER);
+		if (kva == NULL)
+			break;
+		run[cnt] = next;
+		frames[cnt] = vm_new_frame (kva);
+	}
+
+	/* Enter the frames in the swap cache, pinned so that others
+	 * wait for the read, and map them read-only: this process is
+	 * stopped in this fault and cannot touch them early.  The run
+	 * ends at a slot another process is already reading, or at a
+	 * page that cannot be cached or mapped. */
+	lock_acquire (&frame_lock);
+	joined = swap_cache_join (page, &success);
+	for (i = 0; !joined && i < cnt; i++) {
+		if (i > 0 && anon_swap_cache_find (run[i]->anon.slot) != NULL)
+			break;
+		frame_add_page (frames[i], run[i]);
+		if (!anon_swap_cache_fill (run[i]) || !vm_map_page (run[i], false)) {
+			frame_remove_page (run[i]);
+			break;
+		}
+	}
+	for (; cnt > i; cnt--) {
+		frames[cnt - 1]->pinned = false;
+		vm_release_frame (frames[cnt - 1]);
+	}
+	lock_release (&frame_lock);
+	if (cnt == 0)
+		return joined && success;
+
+	anon_swap_in_pages (run, cnt);
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < cnt; i++) {
+		anon_swap_release (run[i]);
+		frames[i]->pinned = false;
+		if (run[i]->writable && frame_is_private (frames[i]))
+			vm_map_page (run[i], true);
+	}
+	cond_broadcast (&fill_cond, &frame_lock);
+	lock_release (&frame_lock);
+	return true;
 }
 
-/* Handle the fault on write_protected page */
+/* Maps PAGE, a neighbour of a faulting page that is not mapped, if
+ * that needs neither eviction nor disk I/O: a page read ahead is
+ * mapped, a page in the swap cache joins its frame, and a
+ * zero-filled page gets a free frame.  A page that would have to be
+ * read from swap or from a file is left alone: the fault that needs
+ * it reads it, and readahead brings in mapped file pages.  Stops
+ * the walk once no frame is free. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+fault_around_page (struct page *page, void *aux UNUSED) {
+	bool success = false;
+	void *kva;
+
+	if (page->frame != NULL) {
+		/* Read ahead, but not mapped yet. */
+		bool resident = false;
+
+		lock_acquire (&frame_lock);
+		if (page->frame != NULL && !page->frame->pinned
+				&& pml4_get_page (page->pml4, page->va) == NULL) {
+			resident = true;
+			success = vm_map_page (page,
+					page->writable && frame_is_private (page->frame));
+		}
+		lock_release (&frame_lock);
+		if (success)
+			__atomic_fetch_add (&fault_around_cnt, 1, __ATOMIC_RELAXED);
+		if (resident && page->mmap != NULL)
+			mmap_access (page, true);
+		return true;
+	}
+
+	if (page->mmap != NULL) {
+		/* Left to readahead. */
+		return true;
+	} else if (page->operations->type == VM_ANON) {
+		struct frame *frame;
+
+		lock_acquire (&frame_lock);
+		frame = anon_swap_cache_find (page->anon.slot);
+		if (frame != NULL && !frame->pinned)
+			swap_cache_join (page, &success);
+		lock_release (&frame_lock);
+	} else if (page_needs_zero (page)) {
+		kva = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (kva == NULL)
+			return false;
+		success = vm_fill_frame (page, vm_new_frame (kva));
+	}
+	if (success)
+		__atomic_fetch_add (&fault_around_cnt, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+/* Maps the pages around PAGE, which has just been claimed, in the
+ * window of vm_fault_around pages that holds it, so that the
+ * process does not fault on each of them in turn. */
+static void
+vm_fault_around_page (struct page *page) {
+	uint64_t vpn = pg_no (page->va);
+	uint64_t start = vpn - vpn % vm_fault_around;
+
+	spt_for_each (&thread_current ()->spt, (void *) (start << PGBITS),
+			(void *) ((start + vm_fault_around) << PGBITS),
+			fault_around_page, NULL);
+}
+
+/* Counts a file page that a write or write-protect fault has just
+ * mapped writable, and so has just dirtied.  Pages mapped writable by a read fault are not
+ * counted until they are written and the next writeback pass sees
+ * their dirty bits.  If the dirty file pages make up
+ * vm_dirty_ratio percent of the frame table, writes some back
+ * before the faulting process goes on, so that it cannot dirty
+ * memory faster than it is cleaned.  A ratio of 0 turns this
+ * off. */
+static void
+vm_balance_dirty (void) {
+	bool over;
+
+	if (vm_dirty_ratio == 0)
+		return;
+
+	lock_acquire (&frame_lock);
+	dirty_file_cnt++;
+	over = dirty_file_cnt * 100
+		>= (size_t) vm_dirty_ratio * list_size (&frame_table);
+	lock_release (&frame_lock);
+	if (over)
+		file_writeback (vm_dirty_ratio);
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+	bool resident, success = false;
 
-	return vm_do_claim_page (page);
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+
+	page = spt_find_page (spt, addr);
+	if (!not_present) {
+		if (page == NULL || !write || !vm_handle_wp (page))
+			return false;
+		if (page_get_type (page) == VM_FILE)
+			vm_balance_dirty ();
+		return true;
+	}
+
+	if (page == NULL) {
+		/* A push may fault up to 8 bytes below the stack pointer. */
+		if (user && (uint64_t) addr >= f->rsp - 8
+				&& (uint64_t) addr >= STACK_LIMIT
+				&& (uint64_t) addr < USER_STACK)
+			return vm_stack_growth (addr);
+		return false;
+	}
+	if (write && !page->writable)
+		return false;
+
+	/* A page read ahead is in memory already, or about to be. */
+	lock_acquire (&frame_lock);
+	while (page->frame != NULL && page->frame->pinned)
+		cond_wait (&fill_cond, &frame_lock);
+	resident = page->frame != NULL;
+	if (resident)
+		success = vm_map_page (page,
+				page->writable && frame_is_private (page->frame));
+	lock_release (&frame_lock);
+
+	if (!resident)
+		success = vm_do_claim_page (page);
+	if (!success)
+		return false;
+	if (page->mmap != NULL)
+		mmap_access (page, resident);
+	if (write && page_get_type (page) == VM_FILE)
+		vm_balance_dirty ();
+	if (vm_fault_around > 1)
+		vm_fault_around_page (page);
+	return true;
+}
+
+/* Prints VM statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM: %lld pages mapped around page faults\n", fault_around_cnt);
 }
 
 /* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
+ *
+ * Only an anonymous page needs the frame lock to be destroyed,
+ * since its swap slot may be in the swap cache.  Destroying a file
+ * page writes it back and closes its file, so its frame is pinned
+ * and unmapped under the lock, and the lock is dropped for the
+ * destroy, as in vm_evict_frame(). */
 void
 vm_dealloc_page (struct page *page) {
-	destroy (page);
-	free (page);
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	while (page->frame != NULL && page->frame->pinned)
+		cond_wait (&fill_cond, &frame_lock);
+	frame = page->frame;
+	if (VM_TYPE (page->operations->type) == VM_ANON) {
+		destroy (page);
+		if (frame != NULL)
+			vm_free_frame (page);
+	} else {
+		if (frame != NULL) {
+			frame->pinned = true;
+			pml4_clear_page (page->pml4, page->va);
+		}
+		lock_release (&frame_lock);
+
+		destroy (page);
+
+		lock_acquire (&frame_lock);
+		if (frame != NULL) {
+			frame->pinned = false;
+			vm_free_frame (page);
+			cond_broadcast (&fill_cond, &frame_lock);
+		}
+	}
+	lock_release (&frame_lock);
+	if (page->mmap != NULL)
+		mmap_region_put (page->mmap);
+	kmem_cache_free (page_cache, page);
+}
+
+/* Gives PAGE, which is not in memory, a free frame, pinned, for
+ * readahead to fill.  Does not map it.  Returns false if no frame is
+ * free; readahead never evicts. */
+bool
+vm_prefetch_begin (struct page *page) {
+	void *kva = palloc_get_page (PAL_USER);
+	struct frame *frame;
+
+	ASSERT (page->frame == NULL);
+
+	if (kva == NULL)
+		return false;
+	frame = vm_new_frame (kva);
+	lock_acquire (&frame_lock);
+	frame_add_page (frame, page);
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Unpins the frame of PAGE once readahead has filled it, with
+ * SUCCESS, and wakes any fault waiting for it.  Frees the frame
+ * if the read failed. */
+void
+vm_prefetch_end (struct page *page, bool success) {
+	struct frame *frame = page->frame;
+
+	lock_acquire (&frame_lock);
+	frame->pinned = false;
+	if (!success) {
+		frame_remove_page (page);
+		vm_release_frame (frame);
+	}
+	cond_broadcast (&fill_cond, &frame_lock);
+	lock_release (&frame_lock);
+}
+
+/* Picks dirty file pages to write back and stores up to MAX of them
+ * in PAGES, returning how many.  Every dirty page is picked if the
+ * dirty pages make up RATIO percent of the frame table or more;
+ * otherwise only the pages that were already dirty at the previous
+ * scan are.  Each page picked has its frame pinned and its dirty
+ * bit cleared, so that a write after the copy starts marks it
+ * dirty again.  The caller writes the pages and passes each to
+ * vm_writeback_end(). */
+size_t
+vm_writeback_begin (struct page *pages[], size_t max, unsigned ratio) {
+	size_t dirty_cnt = 0, cnt = 0;
+	struct list_elem *e;
+	bool all;
+
+	lock_acquire (&frame_lock);
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, table_elem);
+
+		if (frame_is_file (frame)
+				&& pml4_is_dirty (frame->page->pml4, frame->page->va))
+			dirty_cnt++;
+	}
+	all = dirty_cnt * 100 >= (size_t) ratio * list_size (&frame_table);
+
+	for (e = list_begin (&frame_table); e != list_end (&frame_table);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, table_elem);
+		struct page *page = frame->page;
+		bool expired;
+
+		if (!frame_is_file (frame))
+			continue;
+		expired = frame->dirty_seen;
+		frame->dirty_seen = pml4_is_dirty (page->pml4, page->va);
+		if (!frame->dirty_seen || !(all || expired) || cnt == max)
+			continue;
+
+		frame->pinned = true;
+		frame->dirty_seen = false;
+		pml4_set_dirty (page->pml4, page->va, false);
+		pages[cnt++] = page;
+	}
+	dirty_file_cnt = dirty_cnt - cnt;
+	lock_release (&frame_lock);
+	return cnt;
+}
+
+/* Unpins the frame of PAGE, picked by vm_writeback_begin(), once it
+ * has been written back, and wakes any thread waiting for it. */
+void
+vm_writeback_end (struct page *page) {
+	lock_acquire (&frame_lock);
+	page->frame->pinned = false;
+	cond_broadcast (&fill_cond, &frame_lock);
+	lock_release (&frame_lock);
 }
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Claim the PAGE and set up the mmu.  The page is filled before it
+ * is mapped, so the process never sees it half loaded. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	struct frame *frame;
+
+	if (page->operations->type == VM_ANON
+			&& page->anon.slot != SWAP_SLOT_NONE)
+		return vm_claim_swapped (page);
+
+	frame = vm_get_frame (page_needs_zero (page));
+	return vm_fill_frame (page, frame);
+}
+
+/* Fills FRAME, which must be pinned and have no pages, with PAGE and
+ * maps it.  Frees FRAME on failure. */
+static bool
+vm_fill_frame (struct page *page, struct frame *frame) {
+	bool success;
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_add_page (frame, page);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	success = swap_in (page, frame->kva);
 
-	return swap_in (page, frame->kva);
+	lock_acquire (&frame_lock);
+	if (success)
+		success = vm_map_page (page, page->writable);
+	frame->pinned = false;
+	if (!success) {
+		frame_remove_page (page);
+		vm_release_frame (frame);
+	}
+	lock_release (&frame_lock);
+	return success;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = NULL;
+	spt->page_cnt = 0;
+	spt->walk_depth = 0;
+}
+
+/* Mappings copied so far by supplemental_page_table_copy().  The
+ * pages of a mapping are contiguous and copied in address order, so
+ * only the most recent mapping needs remembering. */
+struct copy_state {
+	struct mmap_region *src;            /* The parent's mapping. */
+	struct mmap_region *dst;            /* The child's copy of it. */
+};
+
+/* Makes DST, the copy of SRC, a page of the child's copy of SRC's
+ * mapping, creating that copy first if DST is its first page. */
+static bool
+copy_mmap (struct copy_state *state, struct page *src, struct page *dst) {
+	if (state->src != src->mmap) {
+		state->dst = mmap_region_copy (src->mmap);
+		if (state->dst == NULL)
+			return false;
+		state->src = src->mmap;
+	}
+	mmap_region_add_page (state->dst, dst);
+	return true;
+}
+
+/* Gives DST, the copy of SRC, a mapped file page, a copy of SRC's
+ * frame if SRC is in memory, with SRC's dirty bit.  Mapped pages
+ * are not shared copy-on-write like anonymous ones, since writeback
+ * looks at only one page of each frame.  If SRC is not in memory,
+ * DST reads the file on its first fault. */
+static bool
+copy_file_frame (struct page *src, struct page *dst) {
+	struct frame *frame;
+	bool success = true;
+
+	if (src->frame == NULL)
+		return true;
+
+	/* Allocating may evict, so not under the lock. */
+	frame = vm_get_frame (false);
+	lock_acquire (&frame_lock);
+	while (src->frame != NULL && src->frame->pinned)
+		cond_wait (&fill_cond, &frame_lock);
+	if (src->frame != NULL) {
+		memcpy (frame->kva, src->frame->kva, PGSIZE);
+		frame_add_page (frame, dst);
+		success = vm_map_page (dst, dst->writable);
+		if (success && pml4_is_dirty (src->pml4, src->va))
+			pml4_set_dirty (dst->pml4, dst->va, true);
+		if (!success)
+			frame_remove_page (dst);
+	}
+	frame->pinned = false;
+	if (dst->frame == NULL)
+		vm_release_frame (frame);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Adds a copy of SRC to the running process, whose table is the
+ * destination of supplemental_page_table_copy().  A loaded
+ * anonymous page is not copied: both processes share its frame
+ * copy-on-write.  A mapped file page is copied by copy_file_frame().
+ * Pages still pending are copied pending. */
+static bool
+copy_page (struct page *src, void *state_) {
+	struct copy_state *state = state_;
+	struct page *dst;
+	bool success;
+
+	if (src->operations->type == VM_UNINIT) {
+		struct page_load *load = NULL;
+
+		if (src->uninit.aux != NULL
+				&& (load = page_load_copy (src->uninit.aux)) == NULL)
+			return false;
+		if (!vm_alloc_page_with_initializer (src->uninit.type, src->va,
+					src->writable, src->uninit.init, load)) {
+			page_load_free (load);
+			return false;
+		}
+		return src->mmap == NULL || copy_mmap (state, src,
+				spt_find_page (&thread_current ()->spt, src->va));
+	}
+
+	if (page_get_type (src) == VM_FILE) {
+		dst = file_map_copy (src);
+		return dst != NULL
+			&& (src->mmap == NULL || copy_mmap (state, src, dst))
+			&& copy_file_frame (src, dst);
+	}
+
+	if (!vm_alloc_page (page_get_type (src), src->va, src->writable))
+		return false;
+	dst = spt_find_page (&thread_current ()->spt, src->va);
+
+	/* Turn DST into an anonymous page without filling a frame.  If
+	 * SRC is swapped out, DST shares its slot instead of reading it
+	 * back.  Otherwise both share SRC's frame, write-protected.  The
+	 * parent's entry can be changed directly: it is waiting for us,
+	 * so none of its translations are live in any TLB.  SRC's frame
+	 * may be being evicted; then DST shares the slot it goes to. */
+	lock_acquire (&frame_lock);
+	while (src->frame != NULL && src->frame->pinned)
+		cond_wait (&fill_cond, &frame_lock);
+	success = swap_in (dst, NULL);
+	if (success && src->frame == NULL)
+		anon_swap_share (dst, src);
+	else if (success) {
+		frame_add_page (src->frame, dst);
+		success = vm_map_page (src, false) && vm_map_page (dst, false);
+	}
+	lock_release (&frame_lock);
+	return success;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst.  Must be called by
+ * the process that owns DST, while the process that owns SRC waits.
+ * Copying takes time in the number of pages, not in their size. */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct copy_state state = { NULL, NULL };
+
+	ASSERT (dst == &thread_current ()->spt);
+
+	return spt_for_each (src, NULL, (void *) KERN_BASE, copy_page, &state);
+}
+
+/* Frees the pages under the level-LEVEL NODE, then NODE itself. */
+static void
+spt_destroy_node (uint64_t *node, int level) {
+	size_t i;
+
+	for (i = 0; i < SPT_FANOUT; i++) {
+		if (node[i] == 0)
+			continue;
+		if (level == SPT_LEVELS - 1)
+			vm_dealloc_page ((struct page *) node[i]);
+		else
+			spt_destroy_node (spt_child (node[i]), level + 1);
+	}
+	palloc_free_page (node);
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table.  Each node
+ * is visited once, without unlinking pages one by one. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	if (spt->root != NULL)
+		spt_destroy_node (spt->root, 0);
+	spt->root = NULL;
+	spt->page_cnt = 0;
 }